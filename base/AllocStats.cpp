@@ -0,0 +1,210 @@
+#include "AllocStats.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+// 计数器为静态零初始化的原子变量，在任何构造函数运行前即可使用
+std::atomic<int64_t> liveBytes[AllocStats::SUBSYSTEMS][AllocStats::PHASES];
+std::atomic<uint64_t> allocCount[AllocStats::SUBSYSTEMS][AllocStats::PHASES];
+std::atomic<int64_t> peakBytes[AllocStats::SUBSYSTEMS][AllocStats::PHASES];
+std::atomic<uint64_t> violationCount{0};
+
+// 平凡类型的thread_local变量不需要构造，operator new中可以安全访问
+thread_local AllocStats::Subsystem currentSubsystem = AllocStats::OTHER;
+thread_local AllocStats::Phase currentPhase = AllocStats::NONE;
+thread_local uint64_t threadAllocs = 0;
+// AllowScope中发生的分配次数，NoAllocScope检查时扣除
+thread_local uint64_t threadAllowed = 0;
+
+} // namespace
+
+#ifdef WS_ALLOC_STATS
+
+namespace {
+
+// 每次分配前的头部，记录大小与分配时的标签；16字节保证返回的地址仍按max_align_t对齐
+struct alignas(16) Header {
+    uint64_t size;
+    uint16_t subsystem;
+    uint16_t phase;
+};
+
+void *countedAlloc(size_t size) {
+    auto header = static_cast<Header *>(malloc(sizeof(Header) + size));
+    if (!header) {
+        return nullptr;
+    }
+    header->size = size;
+    header->subsystem = currentSubsystem;
+    header->phase = currentPhase;
+    threadAllocs++;
+    allocCount[currentSubsystem][currentPhase].fetch_add(1, std::memory_order_relaxed);
+    auto live = liveBytes[currentSubsystem][currentPhase].fetch_add(size, std::memory_order_relaxed)
+              + static_cast<int64_t>(size);
+    auto &peak = peakBytes[currentSubsystem][currentPhase];
+    auto old = peak.load(std::memory_order_relaxed);
+    while (live > old && !peak.compare_exchange_weak(old, live, std::memory_order_relaxed)) {
+    }
+    return header + 1;
+}
+
+void countedFree(void *ptr) {
+    if (!ptr) {
+        return;
+    }
+    auto header = static_cast<Header *>(ptr) - 1;
+    liveBytes[header->subsystem][header->phase].fetch_sub(header->size, std::memory_order_relaxed);
+    free(header);
+}
+
+void *throwingAlloc(size_t size) {
+    void *ptr;
+    while (!(ptr = countedAlloc(size))) {
+        auto handler = std::get_new_handler();
+        if (!handler) {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+    return ptr;
+}
+
+} // namespace
+
+void *operator new(size_t size) {
+    return throwingAlloc(size);
+}
+
+void *operator new[](size_t size) {
+    return throwingAlloc(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+    return countedAlloc(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+    return countedAlloc(size);
+}
+
+void operator delete(void *ptr) noexcept {
+    countedFree(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+    countedFree(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    countedFree(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept {
+    countedFree(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept {
+    countedFree(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept {
+    countedFree(ptr);
+}
+
+bool AllocStats::enabled() {
+    return true;
+}
+
+#else
+
+bool AllocStats::enabled() {
+    return false;
+}
+
+#endif
+
+AllocStats::Counter AllocStats::get(Subsystem subsystem, Phase phase) {
+    Counter ret;
+    ret.live = liveBytes[subsystem][phase].load(std::memory_order_relaxed);
+    ret.count = allocCount[subsystem][phase].load(std::memory_order_relaxed);
+    ret.peak = peakBytes[subsystem][phase].load(std::memory_order_relaxed);
+    return ret;
+}
+
+uint64_t AllocStats::threadCount() {
+    return threadAllocs;
+}
+
+uint64_t AllocStats::violations() {
+    return violationCount.load(std::memory_order_relaxed);
+}
+
+void AllocStats::print(FILE *out) {
+    if (!enabled()) {
+        return;
+    }
+    fprintf(out, "allocations (live/peak KB, count):");
+    for (int s = 0; s < SUBSYSTEMS; s++) {
+        for (int p = 0; p < PHASES; p++) {
+            auto counter = get(static_cast<Subsystem>(s), static_cast<Phase>(p));
+            if (counter.count == 0) {
+                continue;
+            }
+            fprintf(out, " %s/%s %lld/%lld %llu,", subsystemName(static_cast<Subsystem>(s)),
+                    phaseName(static_cast<Phase>(p)), (long long)counter.live / 1024,
+                    (long long)counter.peak / 1024, (unsigned long long)counter.count);
+        }
+    }
+    fprintf(out, " %llu unexpected\n", (unsigned long long)violations());
+}
+
+const char *AllocStats::subsystemName(Subsystem subsystem) {
+    static const char *names[SUBSYSTEMS] = {"other", "buffer", "request", "response",
+                                            "log",   "task",   "timer",   "conn"};
+    return names[subsystem];
+}
+
+const char *AllocStats::phaseName(Phase phase) {
+    static const char *names[PHASES] = {"none", "parse", "handle", "write"};
+    return names[phase];
+}
+
+AllocStats::Scope::Scope(Subsystem subsystem) : saved_(currentSubsystem) {
+    currentSubsystem = subsystem;
+}
+
+AllocStats::Scope::~Scope() {
+    currentSubsystem = saved_;
+}
+
+AllocStats::PhaseScope::PhaseScope(Phase phase) : saved_(currentPhase) {
+    currentPhase = phase;
+}
+
+AllocStats::PhaseScope::~PhaseScope() {
+    currentPhase = saved_;
+}
+
+AllocStats::AllowScope::AllowScope() : start_(threadAllocs) {}
+
+AllocStats::AllowScope::~AllowScope() {
+    threadAllowed += threadAllocs - start_;
+}
+
+AllocStats::NoAllocScope::NoAllocScope(const char *what, bool strict) :
+    what_(what), strict_(strict), start_(threadAllocs - threadAllowed) {}
+
+AllocStats::NoAllocScope::~NoAllocScope() {
+    auto n = threadAllocs - threadAllowed - start_;
+    if (n == 0) {
+        return;
+    }
+    violationCount.fetch_add(n, std::memory_order_relaxed);
+    if (strict_) {
+        fprintf(stderr, "%s: %llu unexpected allocations\n", what_, (unsigned long long)n);
+        abort();
+    }
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+
+// 按子系统与请求阶段统计堆分配，仅在以-DWS_ALLOC_STATS=ON构建时替换全局operator new/delete并计数，
+// 默认构建中下面的宏为空，不产生任何开销
+// 分配归属于当前线程最内层的ALLOC_SCOPE与ALLOC_PHASE，释放计入分配时的标签（记录在分配头中）；
+// 只统计经过operator new的分配，Buffer标准块与文件缓存取自大页arena，另见其各自的统计
+class AllocStats {
+public:
+    enum Subsystem { OTHER, BUFFER, REQUEST, RESPONSE, LOG, TASK, TIMER, CONN, SUBSYSTEMS };
+    enum Phase { NONE, PARSE, HANDLE, WRITE, PHASES };
+
+    struct Counter {
+        // 当前未释放的字节数、累计分配次数与未释放字节数的峰值
+        int64_t live = 0;
+        uint64_t count = 0;
+        int64_t peak = 0;
+    };
+
+    // 是否以计数模式构建
+    static bool enabled();
+
+    static Counter get(Subsystem subsystem, Phase phase);
+    // 当前线程累计的分配次数，用于检查一段代码是否分配：前后两次的值相等即没有分配
+    static uint64_t threadCount();
+    // ALLOC_EXPECT_NONE范围内发生了分配的次数
+    static uint64_t violations();
+
+    // 输出有分配记录的标签，未以计数模式构建时不输出
+    static void print(FILE *out);
+
+    static const char *subsystemName(Subsystem subsystem);
+    static const char *phaseName(Phase phase);
+
+    // 在作用域内将当前线程的分配归属于subsystem
+    class Scope {
+    public:
+        explicit Scope(Subsystem subsystem);
+        ~Scope();
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        Subsystem saved_;
+    };
+
+    // 在作用域内将当前线程的分配归属于phase
+    class PhaseScope {
+    public:
+        explicit PhaseScope(Phase phase);
+        ~PhaseScope();
+        PhaseScope(const PhaseScope &) = delete;
+        PhaseScope &operator=(const PhaseScope &) = delete;
+
+    private:
+        Phase saved_;
+    };
+
+    // 作用域内的分配不计入外层的NoAllocScope，用于不分配范围内只走一次的冷路径（如文件首次读入缓存）
+    class AllowScope {
+    public:
+        AllowScope();
+        ~AllowScope();
+        AllowScope(const AllowScope &) = delete;
+        AllowScope &operator=(const AllowScope &) = delete;
+
+    private:
+        uint64_t start_;
+    };
+
+    // 作用域内不应有分配，有分配时计入violations()；strict为true时输出what并abort
+    class NoAllocScope {
+    public:
+        explicit NoAllocScope(const char *what, bool strict = false);
+        ~NoAllocScope();
+        NoAllocScope(const NoAllocScope &) = delete;
+        NoAllocScope &operator=(const NoAllocScope &) = delete;
+
+    private:
+        const char *what_;
+        bool strict_;
+        uint64_t start_;
+    };
+};
+
+#ifdef WS_ALLOC_STATS
+#define ALLOC_CONCAT_(a, b) a##b
+#define ALLOC_CONCAT(a, b) ALLOC_CONCAT_(a, b)
+#define ALLOC_SCOPE(subsystem) \
+    AllocStats::Scope ALLOC_CONCAT(allocScope_, __LINE__)(AllocStats::subsystem)
+#define ALLOC_PHASE(phase) \
+    AllocStats::PhaseScope ALLOC_CONCAT(allocPhase_, __LINE__)(AllocStats::phase)
+#define ALLOC_EXPECT_NONE(what) \
+    AllocStats::NoAllocScope ALLOC_CONCAT(noAlloc_, __LINE__)(what)
+#define ALLOC_ALLOW() AllocStats::AllowScope ALLOC_CONCAT(allocAllow_, __LINE__)
+#else
+#define ALLOC_SCOPE(subsystem) ((void)0)
+#define ALLOC_PHASE(phase) ((void)0)
+#define ALLOC_EXPECT_NONE(what) ((void)0)
+#define ALLOC_ALLOW() ((void)0)
+#endif
@@ -1,30 +1,305 @@
 #include "Buffer.hpp"
 
-//#include <iostream>
+#include <sched.h>
 #include <unistd.h>  // write
 #include <sys/uio.h> //readv
+#include <algorithm>
 #include <cassert>
+#include <mutex>
+#include <new>
+#include <vector>
 
-Buffer::Buffer(int initBuffSize) : buffer_(initBuffSize), readPos_(0), writePos_(0) {}
+#include "AllocStats.hpp"
+#include "HugePageArena.hpp"
+#include "Numa.hpp"
+
+namespace {
+
+// 块的两种规格：标准块与合并数据用的大块，各有自己的空闲链表
+enum SizeClass { STANDARD, LARGE, SIZE_CLASSES };
+
+struct ClassInfo {
+    size_t size;
+    // 线程空闲链表的上限，与共享空闲链表或arena一次交换的块数
+    size_t maxChunks;
+    size_t batch;
+};
+
+const ClassInfo CLASSES[SIZE_CLASSES] = {
+    {Buffer::CHUNK_SIZE, 1024, 32},
+    {Buffer::LARGE_CHUNK_SIZE, 16, 2},
+};
+
+// 同一节点上所有线程共享的空闲块链表，线程的空闲链表为空或溢出时与之批量交换
+struct SharedPool {
+    std::mutex mtx;
+    void *head = nullptr;
+    size_t count = 0;
+
+    void push(void *chunk) {
+        *static_cast<void **>(chunk) = head;
+        head = chunk;
+        count++;
+    }
+};
+
+// 每个NUMA节点一个arena与一组共享空闲链表，arena的区域绑定到该节点；
+// 块取自大页arena，减少TLB缺失，块不归还给系统，而是在空闲链表间流转
+struct NodeChunks {
+    NodeChunks(int node, bool bind) :
+        arena(4 * HugePageArena::HUGE_PAGE_SIZE, bind ? node : -1) {}
+
+    HugePageArena arena;
+    SharedPool shared[SIZE_CLASSES];
+};
+
+// arena与共享空闲链表有意不析构：线程退出时的空闲链表析构可能晚于静态对象
+const std::vector<NodeChunks *> &nodeChunks() {
+    static auto nodes = [] {
+        auto &topology = NumaTopology::get();
+        auto ret = new std::vector<NodeChunks *>;
+        for (int i = 0; i < topology.nodeCount(); i++) {
+            // 只有一个节点时不必绑定
+            ret->push_back(new NodeChunks(i, topology.nodeCount() > 1));
+        }
+        return ret;
+    }();
+    return *nodes;
+}
+
+// 调用者当前所在CPU的节点
+int currentNode() {
+    auto &topology = NumaTopology::get();
+    if (topology.nodeCount() == 1) {
+        return 0;
+    }
+    int node = topology.nodeOf(sched_getcpu());
+    return node >= 0 ? node : 0;
+}
+
+// 线程的空闲块链表，其中的块都属于node节点，线程退出时归还到该节点的共享空闲链表；
+// 块可以在一个线程中取得而在另一个线程中归还，属于其他节点的块直接归还到所属节点
+struct ChunkPool {
+    explicit ChunkPool(SizeClass c) : cls(c), info(CLASSES[c]) {}
+
+    SizeClass cls;
+    const ClassInfo &info;
+    int node = 0;
+    void *head = nullptr;
+    size_t count = 0;
+
+    void push(void *chunk) {
+        *static_cast<void **>(chunk) = head;
+        head = chunk;
+        count++;
+    }
+
+    void *pop() {
+        void *chunk = head;
+        head = *static_cast<void **>(head);
+        count--;
+        return chunk;
+    }
+
+    // 从当前节点的共享空闲链表取得一批块，没有时从该节点的arena中分配；
+    // 只在空闲链表为空时调用，线程迁移到其他节点后此后取得的块也随之改变
+    void refill() {
+        node = currentNode();
+        auto chunks = nodeChunks()[node];
+        {
+            auto &shared = chunks->shared[cls];
+            std::lock_guard<std::mutex> locker(shared.mtx);
+            while (shared.head && count < info.batch) {
+                void *chunk = shared.head;
+                shared.head = *static_cast<void **>(chunk);
+                shared.count--;
+                push(chunk);
+            }
+        }
+        if (count == 0) {
+            auto mem = static_cast<char *>(
+                chunks->arena.allocate(info.batch * info.size, Buffer::CHUNK_SIZE));
+            for (size_t i = 0; i < info.batch; i++) {
+                push(mem + i * info.size);
+            }
+        }
+    }
+
+    // 将n个块归还到所属节点的共享空闲链表
+    void spill(size_t n) {
+        auto &shared = nodeChunks()[node]->shared[cls];
+        std::lock_guard<std::mutex> locker(shared.mtx);
+        while (head && n-- > 0) {
+            shared.push(pop());
+        }
+    }
+
+    ~ChunkPool() { spill(count); }
+};
+
+thread_local ChunkPool pools[SIZE_CLASSES] = {ChunkPool(STANDARD), ChunkPool(LARGE)};
+
+// 没有任何块时Peek与BeginWrite返回的位置
+char emptyData[1] = {'\0'};
+
+} // namespace
+
+std::atomic<size_t> Buffer::heldBytes_{0};
+
+HugePageArena::Stats Buffer::ArenaStats() {
+    HugePageArena::Stats total;
+    for (auto chunks : nodeChunks()) {
+        auto stats = chunks->arena.stats();
+        for (int i = 0; i < HugePageArena::BACKINGS; i++) {
+            total.mapped[i] += stats.mapped[i];
+        }
+        total.used += stats.used;
+    }
+    return total;
+}
+
+Buffer::Buffer(int) :
+    head_(nullptr), tail_(nullptr), readPos_(0), readable_(0), spareChunks_(SPARE_CHUNKS) {}
+
+Buffer::~Buffer() {
+    while (head_) {
+        auto next = head_->next;
+        Drop_(head_);
+        head_ = next;
+    }
+}
+
+Buffer::Chunk *Buffer::Acquire_(size_t cap) {
+    ALLOC_SCOPE(BUFFER);
+    Chunk *chunk;
+    if (cap <= LARGE_CHUNK_CAP) {
+        auto &pool = pools[cap <= CHUNK_CAP ? STANDARD : LARGE];
+        if (!pool.head) {
+            pool.refill();
+        }
+        chunk = static_cast<Chunk *>(pool.pop());
+        chunk->cap = pool.info.size - sizeof(Chunk);
+        chunk->node = pool.node;
+    } else {
+        // 超出大块的按标准块的整数倍分配，不进入空闲链表
+        size_t total = (cap + sizeof(Chunk) + CHUNK_SIZE - 1) / CHUNK_SIZE * CHUNK_SIZE;
+        chunk = static_cast<Chunk *>(::operator new(total));
+        chunk->cap = total - sizeof(Chunk);
+    }
+    chunk->next = nullptr;
+    chunk->size = 0;
+    chunk->begin = 0;
+    return chunk;
+}
+
+void Buffer::Release_(Chunk *chunk) {
+    if (chunk->cap != CHUNK_CAP && chunk->cap != LARGE_CHUNK_CAP) {
+        ::operator delete(chunk);
+        return;
+    }
+    auto &pool = pools[chunk->cap == CHUNK_CAP ? STANDARD : LARGE];
+    if (chunk->node != pool.node) {
+        // 其他节点上取得的块，只在多节点时出现
+        auto &shared = nodeChunks()[chunk->node]->shared[pool.cls];
+        std::lock_guard<std::mutex> locker(shared.mtx);
+        shared.push(chunk);
+        return;
+    }
+    if (pool.count >= pool.info.maxChunks) {
+        pool.spill(pool.info.batch);
+    }
+    pool.push(chunk);
+}
+
+Buffer::Chunk *Buffer::Take_(size_t cap) {
+    auto chunk = Acquire_(cap);
+    Hold_(chunk);
+    return chunk;
+}
+
+void Buffer::Drop_(Chunk *chunk) {
+    heldBytes_.fetch_sub(sizeof(Chunk) + chunk->cap, std::memory_order_relaxed);
+    Release_(chunk);
+}
+
+void Buffer::PushChunk_(Chunk *chunk) {
+    if (tail_) {
+        tail_->next = chunk;
+    } else {
+        head_ = chunk;
+        readPos_ = 0;
+    }
+    tail_ = chunk;
+}
 
 size_t Buffer::ReadableBytes() const {
-    return writePos_ - readPos_;
+    return readable_;
 }
+
 size_t Buffer::WritableBytes() const {
-    return buffer_.size() - writePos_;
+    return tail_ ? tail_->cap - tail_->size : 0;
 }
 
 size_t Buffer::PrependableBytes() const {
     return readPos_;
 }
 
+size_t Buffer::ContiguousBytes() const {
+    return head_ ? head_->size - readPos_ : 0;
+}
+
 const char *Buffer::Peek() const {
-    return BeginPtr_() + readPos_;
+    return head_ ? head_->data() + readPos_ : emptyData;
+}
+
+const char *Buffer::Linearize(size_t len) {
+    assert(len <= readable_);
+    if (ContiguousBytes() >= len) {
+        return Peek();
+    }
+    // 只复制前len字节，最后一个块中其余的数据留在原处，从begin开始读取
+    auto merged = Take_(len);
+    auto chunk = head_;
+    size_t offset = readPos_;
+    while (merged->size < len) {
+        size_t n = std::min(chunk->size - offset, len - merged->size);
+        memcpy(merged->data() + merged->size, chunk->data() + offset, n);
+        merged->size += n;
+        if (offset + n < chunk->size) {
+            chunk->begin = offset + n;
+            break;
+        }
+        auto next = chunk->next;
+        if (chunk == tail_) {
+            tail_ = merged;
+        }
+        Drop_(chunk);
+        chunk = next;
+        offset = chunk ? chunk->begin : 0;
+    }
+    merged->next = chunk;
+    head_ = merged;
+    readPos_ = 0;
+    return head_->data();
 }
 
 void Buffer::Retrieve(size_t len) {
     assert(len <= ReadableBytes());
+    readable_ -= len;
     readPos_ += len;
+    while (head_ != tail_ && readPos_ >= head_->size) {
+        readPos_ -= head_->size;
+        auto next = head_->next;
+        Drop_(head_);
+        head_ = next;
+        readPos_ += head_->begin;
+    }
+    if (readable_ == 0 && head_) {
+        // 数据已全部取走，从块的开头重新写入
+        readPos_ = 0;
+        head_->size = 0;
+        head_->begin = 0;
+    }
 }
 
 void Buffer::RetrieveUntil(const char *end) {
@@ -33,27 +308,63 @@ void Buffer::RetrieveUntil(const char *end) {
 }
 
 void Buffer::RetrieveAll() {
-    bzero(buffer_.data(), buffer_.size());
+    // 只保留第一个标准块，不清零
+    if (head_) {
+        auto chunk = head_->next;
+        while (chunk) {
+            auto next = chunk->next;
+            Drop_(chunk);
+            chunk = next;
+        }
+        head_->next = nullptr;
+        head_->size = 0;
+        head_->begin = 0;
+        tail_ = head_;
+        if (head_->cap != CHUNK_CAP) {
+            Drop_(head_);
+            head_ = tail_ = nullptr;
+        }
+    }
     readPos_ = 0;
-    writePos_ = 0;
+    readable_ = 0;
+}
+
+void Buffer::Shrink() {
+    if (readable_ == 0) {
+        RetrieveAll();
+        if (head_) {
+            Drop_(head_);
+            head_ = tail_ = nullptr;
+        }
+    }
 }
 
 std::string Buffer::RetrieveAllToStr() {
-    std::string str(Peek(), ReadableBytes());
+    std::string str;
+    str.reserve(readable_);
+    for (auto chunk = head_; chunk; chunk = chunk->next) {
+        size_t offset = chunk == head_ ? readPos_ : chunk->begin;
+        str.append(chunk->data() + offset, chunk->size - offset);
+    }
     RetrieveAll();
     return str;
 }
 
-const char *Buffer::BeginWriteConst() const {
-    return BeginPtr_() + writePos_;
+const char *Buffer::BeginWriteConst() {
+    return Linearize(readable_) + readable_;
 }
 
 char *Buffer::BeginWrite() {
-    return BeginPtr_() + writePos_;
+    return tail_ ? tail_->data() + tail_->size : emptyData;
 }
 
 void Buffer::HasWritten(size_t len) {
-    writePos_ += len;
+    assert(len <= WritableBytes());
+    if (len == 0) {
+        return;
+    }
+    tail_->size += len;
+    readable_ += len;
 }
 
 void Buffer::Append(const std::string &str) {
@@ -67,71 +378,117 @@ void Buffer::Append(const void *data, size_t len) {
 
 void Buffer::Append(const char *str, size_t len) {
     assert(str);
-    EnsureWriteable(len);
-    std::copy(str, str + len, BeginWrite());
-    HasWritten(len);
+    // 写满当前块后接上新块，不移动已有数据
+    while (len > 0) {
+        if (WritableBytes() == 0) {
+            EnsureWriteable(1);
+        }
+        size_t n = std::min(len, WritableBytes());
+        memcpy(BeginWrite(), str, n);
+        HasWritten(n);
+        str += n;
+        len -= n;
+    }
 }
 
 void Buffer::Append(const Buffer &buff) {
-    Append(buff.Peek(), buff.ReadableBytes());
+    for (auto chunk = buff.head_; chunk; chunk = chunk->next) {
+        size_t offset = chunk == buff.head_ ? buff.readPos_ : chunk->begin;
+        Append(chunk->data() + offset, chunk->size - offset);
+    }
 }
 
 void Buffer::EnsureWriteable(size_t len) {
-    if (WritableBytes() < len) {
-        MakeSpace_(len);
+    if (WritableBytes() >= len) {
+        return;
+    }
+    if (tail_ && readable_ == 0) {
+        // 唯一的块中没有数据但容量不够，直接换成足够大的块
+        Drop_(tail_);
+        head_ = tail_ = nullptr;
     }
+    PushChunk_(Take_(len));
     assert(WritableBytes() >= len);
 }
 
 ssize_t Buffer::ReadFd(int fd, int *saveErrno) {
-    char buff[65535];
-    struct iovec iov[2];
+    struct iovec iov[READ_CHUNKS + 1];
+    Chunk *chunks[READ_CHUNKS];
+    int cnt = 0;
+    /* 分散读：先填满当前块，再直接读入新块，不经过中间缓冲区；
+       新块的数量随上一次是否读满而增减，小请求只占用当前块与少量新块 */
     const size_t writable = WritableBytes();
-    /* 分散读， 保证数据全部读完 */
-    iov[0].iov_base = BeginPtr_() + writePos_;
-    iov[0].iov_len = writable;
-    iov[1].iov_base = buff;
-    iov[1].iov_len = sizeof(buff);
+    const int spare = spareChunks_;
+    if (writable > 0) {
+        iov[cnt].iov_base = BeginWrite();
+        iov[cnt].iov_len = writable;
+        cnt++;
+    }
+    for (int i = 0; i < spare; i++) {
+        chunks[i] = Acquire_(CHUNK_CAP);
+        iov[cnt].iov_base = chunks[i]->data();
+        iov[cnt].iov_len = chunks[i]->cap;
+        cnt++;
+    }
 
-    const ssize_t len = readv(fd, iov, 2);
+    const ssize_t len = readv(fd, iov, cnt);
     if (len < 0) {
         *saveErrno = errno;
-    } else if (static_cast<size_t>(len) <= writable) {
-        writePos_ += len;
+    }
+    size_t left = len > 0 ? len : 0;
+    if (left == writable + spare * CHUNK_CAP) {
+        spareChunks_ = spare * 2 < READ_CHUNKS ? spare * 2 : READ_CHUNKS;
     } else {
-        writePos_ = buffer_.size();
-        Append(buff, len - writable);
+        spareChunks_ = SPARE_CHUNKS;
+    }
+    size_t n = std::min(left, writable);
+    HasWritten(n);
+    left -= n;
+    for (int i = 0; i < spare; i++) {
+        if (left == 0) {
+            Release_(chunks[i]);
+            continue;
+        }
+        n = std::min(left, chunks[i]->cap);
+        Hold_(chunks[i]);
+        PushChunk_(chunks[i]);
+        HasWritten(n);
+        left -= n;
     }
     return len;
 }
 
-ssize_t Buffer::WriteFd(int fd, int *saveErrno) {
-    size_t readSize = ReadableBytes();
-    ssize_t len = write(fd, Peek(), readSize);
+ssize_t Buffer::WriteFd(int fd, int *saveErrno, struct iovec *extra) {
+    struct iovec iov[READ_CHUNKS + 1];
+    int cnt = 0;
+    size_t buffered = 0;
+    auto chunk = head_;
+    for (; chunk && cnt < READ_CHUNKS; chunk = chunk->next) {
+        size_t offset = chunk == head_ ? readPos_ : chunk->begin;
+        if (chunk->size > offset) {
+            iov[cnt].iov_base = chunk->data() + offset;
+            iov[cnt].iov_len = chunk->size - offset;
+            buffered += iov[cnt].iov_len;
+            cnt++;
+        }
+    }
+    // 缓冲区的数据全部放入后才接上extra，保持发送顺序
+    if (!chunk && extra && extra->iov_len > 0) {
+        iov[cnt++] = *extra;
+    }
+    if (cnt == 0) {
+        return 0;
+    }
+    ssize_t len = writev(fd, iov, cnt);
     if (len < 0) {
         *saveErrno = errno;
         return len;
     }
-    readPos_ += len;
+    size_t n = std::min(static_cast<size_t>(len), buffered);
+    Retrieve(n);
+    if (static_cast<size_t>(len) > n) {
+        extra->iov_base = static_cast<char *>(extra->iov_base) + (len - n);
+        extra->iov_len -= len - n;
+    }
     return len;
 }
-
-char *Buffer::BeginPtr_() {
-    return &*buffer_.begin();
-}
-
-const char *Buffer::BeginPtr_() const {
-    return &*buffer_.begin();
-}
-
-void Buffer::MakeSpace_(size_t len) {
-    if (WritableBytes() + PrependableBytes() < len) {
-        buffer_.resize(writePos_ + len + 1);
-    } else {
-        size_t readable = ReadableBytes();
-        std::copy(BeginPtr_() + readPos_, BeginPtr_() + writePos_, BeginPtr_());
-        readPos_ = 0;
-        writePos_ = readPos_ + readable;
-        assert(readable == ReadableBytes());
-    }
-}
\ No newline at end of file
@@ -1,30 +1,65 @@
 #pragma once
 
+#include <sys/types.h>
+#include <sys/uio.h> // iovec
+#include <atomic>
 #include <cstring> //perror
-#include <vector>  //readv
 #include <string>
-#include <atomic>
 
+#include "HugePageArena.hpp"
+
+// 由固定大小的块串成的缓冲区，块取自每个线程各自的空闲链表，只由一个线程（连接的所有者）访问；
+// 块从调用者所在NUMA节点的大页arena中批量分配，线程的空闲链表为空或溢出时与该节点的共享空闲链表批量交换
+// 读取时readv直接读入块中，发送时writev直接从块中发出，RetrieveAll只重置位置而不清零，
+// 超出标准大小的块（合并数据时产生）在RetrieveAll时归还；
+// Peek只返回第一个块中的连续数据，不合并；需要连续数据的调用者（如请求头的解析）用Linearize
+// 只合并所需的前缀，合并用的块同样取自空闲链表
 class Buffer {
 public:
+    // 块的大小（包括块头），空闲块在线程的空闲链表中复用
+    static const size_t CHUNK_SIZE = 4096;
+    // 合并数据时使用的大块，同样在空闲链表中复用；可以放下HTTP请求头的上限（32KB）
+    static const size_t LARGE_CHUNK_SIZE = 16 * CHUNK_SIZE;
+
+    // initBuffSize仅为兼容保留，块在首次写入时才分配
     Buffer(int initBuffSize = 1024);
-    ~Buffer() = default;
+    ~Buffer();
 
+    Buffer(const Buffer &) = delete;
+    Buffer &operator=(const Buffer &) = delete;
+
+    // 最后一个块中可直接写入的连续字节数
     size_t WritableBytes() const;
     size_t ReadableBytes() const;
     size_t PrependableBytes() const;
 
+    // 第一个块中可读数据的开头，连续的字节数为ContiguousBytes()
     const char *Peek() const;
+    size_t ContiguousBytes() const;
+    // 使前len字节的可读数据连续并返回其开头，只复制所需的字节，其余数据留在原来的块中；
+    // len不超过大块的容量时不分配内存
+    const char *Linearize(size_t len);
     void EnsureWriteable(size_t len);
     void HasWritten(size_t len);
 
     void Retrieve(size_t len);
+    // end须位于Peek()开始的连续数据中
     void RetrieveUntil(const char *end);
 
     void RetrieveAll();
     std::string RetrieveAllToStr();
 
-    const char *BeginWriteConst() const;
+    // 没有可读数据时归还所有块，空闲的缓冲区不占用内存
+    void Shrink();
+
+    // 所有缓冲区当前持有的块的总字节数（不包括空闲链表中的块）
+    static size_t HeldBytes() { return heldBytes_.load(std::memory_order_relaxed); }
+    // 标准块所在arena的映射情况
+    static HugePageArena::Stats ArenaStats();
+
+    // 可读数据的末尾，会先合并全部可读数据
+    const char *BeginWriteConst();
+    // 最后一个块的写入位置
     char *BeginWrite();
 
     void Append(const std::string &str);
@@ -33,14 +68,51 @@ public:
     void Append(const Buffer &buff);
 
     ssize_t ReadFd(int fd, int *Errno);
-    ssize_t WriteFd(int fd, int *Errno);
+    // 以一次writev依次发送各块中的数据，extra不为空时在缓冲区的数据之后接着发送extra（如映射的文件），
+    // 发出的字节从缓冲区取走并从extra中扣除
+    ssize_t WriteFd(int fd, int *Errno, struct iovec *extra = nullptr);
 
 private:
-    char *BeginPtr_();
-    const char *BeginPtr_() const;
-    void MakeSpace_(size_t len);
-
-    std::vector<char> buffer_;
-    std::atomic<std::size_t> readPos_;
-    std::atomic<std::size_t> writePos_;
-};
\ No newline at end of file
+    struct Chunk {
+        Chunk *next;
+        // 数据区大小与已写入的字节数
+        size_t cap;
+        size_t size;
+        // 数据的起始位置，只有部分数据被Linearize复制走的块不为0
+        size_t begin;
+        // 块所在的NUMA节点，归还时回到该节点的空闲链表
+        int node;
+
+        char *data() { return reinterpret_cast<char *>(this + 1); }
+    };
+
+    // 数据区大小为CHUNK_SIZE减去块头的块称为标准块，可在空闲链表中复用
+    static const size_t CHUNK_CAP = CHUNK_SIZE - sizeof(Chunk);
+    static const size_t LARGE_CHUNK_CAP = LARGE_CHUNK_SIZE - sizeof(Chunk);
+    // 一次readv最多额外读入的标准块数
+    static const int READ_CHUNKS = 16;
+    // 一次readv通常额外准备的标准块数，上一次读满所有块时加倍，直到READ_CHUNKS
+    static const int SPARE_CHUNKS = 2;
+
+    // 取得数据区至少为cap字节的块，不超过LARGE_CHUNK_CAP时取自本线程对应大小的空闲链表
+    static Chunk *Acquire_(size_t cap);
+    static void Release_(Chunk *chunk);
+    // 与Acquire_、Release_相同，同时计入heldBytes_，用于放入链中的块
+    static Chunk *Take_(size_t cap);
+    static void Drop_(Chunk *chunk);
+    static void Hold_(Chunk *chunk) {
+        heldBytes_.fetch_add(sizeof(Chunk) + chunk->cap, std::memory_order_relaxed);
+    }
+
+    void PushChunk_(Chunk *chunk);
+
+    // head_为可读数据所在的第一个块，tail_为写入的块；readPos_为head_中的读取位置
+    Chunk *head_;
+    Chunk *tail_;
+    size_t readPos_;
+    size_t readable_;
+    // 下一次readv额外准备的标准块数
+    int spareChunks_;
+
+    static std::atomic<size_t> heldBytes_;
+};
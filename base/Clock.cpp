@@ -0,0 +1,116 @@
+#include "Clock.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+namespace {
+
+struct ClockState {
+    std::atomic<int64_t> monoMs{0};
+    std::atomic<int64_t> wallUs{0};
+    // 以下格式化结果只在秒数变化时由一个线程重写，读取方按seq判断是否读到了写了一半的值
+    std::atomic<int64_t> formattedSec{-1};
+    std::atomic<uint32_t> seq{0};
+    std::atomic_flag formatting = ATOMIC_FLAG_INIT;
+    char logPrefix[CoarseClock::LOG_PREFIX_LEN];
+    char httpDate[CoarseClock::HTTP_DATE_LEN];
+    int mday = 0;
+};
+
+ClockState state;
+
+const char *const WEEKDAYS[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+const char *const MONTHS[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                              "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+void format(time_t sec) {
+    tm local{}, gmt{};
+    localtime_r(&sec, &local);
+    gmtime_r(&sec, &gmt);
+    char prefix[64], date[64];
+    snprintf(prefix, sizeof(prefix), "%04d-%02d-%02d %02d:%02d:%02d", local.tm_year + 1900,
+             local.tm_mon + 1, local.tm_mday, local.tm_hour, local.tm_min, local.tm_sec);
+    snprintf(date, sizeof(date), "%s, %02d %s %04d %02d:%02d:%02d GMT", WEEKDAYS[gmt.tm_wday],
+             gmt.tm_mday, MONTHS[gmt.tm_mon], gmt.tm_year + 1900, gmt.tm_hour, gmt.tm_min,
+             gmt.tm_sec);
+    auto seq = state.seq.load(std::memory_order_relaxed);
+    state.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(state.logPrefix, prefix, CoarseClock::LOG_PREFIX_LEN);
+    memcpy(state.httpDate, date, CoarseClock::HTTP_DATE_LEN);
+    state.mday = local.tm_mday;
+    state.seq.store(seq + 2, std::memory_order_release);
+}
+
+// 尚未有线程更新过时钟时（如启动阶段）先更新一次，其他线程正在首次格式化时等待其完成
+void ensure() {
+    while (state.formattedSec.load(std::memory_order_acquire) < 0) {
+        CoarseClock::update();
+    }
+}
+
+// 读取格式化结果，与format同时进行时重试
+template <typename Copy> void readFormatted(Copy copy) {
+    ensure();
+    uint32_t before, after;
+    do {
+        before = state.seq.load(std::memory_order_acquire);
+        copy();
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = state.seq.load(std::memory_order_relaxed);
+    } while ((before & 1) || before != after);
+}
+
+} // namespace
+
+void CoarseClock::update() {
+    timespec mono, wall;
+    // 粗粒度时钟由vDSO直接读取，不进入内核
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &mono);
+    clock_gettime(CLOCK_REALTIME_COARSE, &wall);
+    state.monoMs.store(mono.tv_sec * 1000LL + mono.tv_nsec / 1000000, std::memory_order_relaxed);
+    state.wallUs.store(wall.tv_sec * 1000000LL + wall.tv_nsec / 1000, std::memory_order_relaxed);
+    if (wall.tv_sec == state.formattedSec.load(std::memory_order_acquire)) {
+        return;
+    }
+    // 多个IO线程同时发现秒数变化时只由一个线程格式化
+    if (state.formatting.test_and_set(std::memory_order_acquire)) {
+        return;
+    }
+    if (wall.tv_sec != state.formattedSec.load(std::memory_order_relaxed)) {
+        format(wall.tv_sec);
+        state.formattedSec.store(wall.tv_sec, std::memory_order_release);
+    }
+    state.formatting.clear(std::memory_order_release);
+}
+
+int64_t CoarseClock::monotonicMs() {
+    ensure();
+    return state.monoMs.load(std::memory_order_relaxed);
+}
+
+void CoarseClock::setMonotonicMs(int64_t ms) {
+    // 先完成首次更新，之后的读取不会再覆盖设置的值
+    ensure();
+    state.monoMs.store(ms, std::memory_order_relaxed);
+}
+
+int64_t CoarseClock::wallUs() {
+    ensure();
+    return state.wallUs.load(std::memory_order_relaxed);
+}
+
+int CoarseClock::logPrefix(char *buf) {
+    int mday;
+    readFormatted([buf, &mday] {
+        memcpy(buf, state.logPrefix, LOG_PREFIX_LEN);
+        mday = state.mday;
+    });
+    return mday;
+}
+
+void CoarseClock::httpDate(char *buf) {
+    readFormatted([buf] { memcpy(buf, state.httpDate, HTTP_DATE_LEN); });
+}
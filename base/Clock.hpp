@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+
+// 粗粒度时钟：IO线程每轮循环读取一次时间并缓存，其他地方只读取缓存的值，
+// 热路径上不进入内核，也不调用libc的时间格式化；精度为一轮循环（阻塞时由定时器保证至少每秒更新）
+// 秒数变化时才重新格式化日志时间前缀与HTTP Date，格式化结果可在任意线程中读取
+class CoarseClock {
+public:
+    // "2024-01-02 03:04:05"
+    static const int LOG_PREFIX_LEN = 19;
+    // "Tue, 02 Jan 2024 03:04:05 GMT"（RFC 7231 IMF-fixdate）
+    static const int HTTP_DATE_LEN = 29;
+
+    // 读取单调时钟与墙上时钟并更新缓存，可在任意线程中调用
+    static void update();
+
+    // 单调时钟的毫秒数
+    static int64_t monotonicMs();
+
+    // 直接设置缓存的单调时钟，到下一次update前monotonicMs都返回ms；只用于测试中控制时间
+    static void setMonotonicMs(int64_t ms);
+
+    // 自1970年以来的微秒数
+    static int64_t wallUs();
+
+    // 写入LOG_PREFIX_LEN个字符的本地时间，返回对应的日（1-31），用于判断日志是否需要按天切分
+    static int logPrefix(char *buf);
+
+    // 写入HTTP_DATE_LEN个字符的GMT时间
+    static void httpDate(char *buf);
+};
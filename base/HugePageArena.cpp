@@ -0,0 +1,102 @@
+#include "HugePageArena.hpp"
+
+#include <sys/mman.h>
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <new>
+#include <string>
+
+#include "Numa.hpp"
+
+// 透明大页设置为never时MADV_HUGEPAGE不会生效
+static bool thpEnabled() {
+    static const bool enabled = [] {
+        std::ifstream in("/sys/kernel/mm/transparent_hugepage/enabled");
+        std::string line;
+        std::getline(in, line);
+        return !line.empty() && line.find("[never]") == std::string::npos;
+    }();
+    return enabled;
+}
+
+const size_t HugePageArena::HUGE_PAGE_SIZE;
+
+HugePageArena::HugePageArena(size_t regionSize, int node) :
+    regionSize_((regionSize + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE), node_(node) {}
+
+HugePageArena::~HugePageArena() {
+    for (auto &region : regions_) {
+        munmap(region.base, region.size);
+    }
+}
+
+HugePageArena::Region HugePageArena::map(size_t size) {
+    size = (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    if (!hugetlbFailed_) {
+        void *mem = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (mem != MAP_FAILED) {
+            bind(mem, size);
+            return {static_cast<char *>(mem), size, HUGETLB};
+        }
+        // 未预留大页（vm.nr_hugepages为0）或已用完
+        hugetlbFailed_ = true;
+    }
+    // 多映射一个大页再裁掉首尾，使区域按大页对齐，透明大页才能覆盖整个区域
+    size_t total = size + HUGE_PAGE_SIZE;
+    void *mem = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+    auto addr = reinterpret_cast<uintptr_t>(mem);
+    auto aligned = (addr + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+    if (aligned > addr) {
+        munmap(mem, aligned - addr);
+    }
+    if (aligned + size < addr + total) {
+        munmap(reinterpret_cast<void *>(aligned + size), addr + total - aligned - size);
+    }
+    auto base = reinterpret_cast<char *>(aligned);
+    bind(base, size);
+    auto backing = REGULAR;
+    if (thpEnabled() && madvise(base, size, MADV_HUGEPAGE) == 0) {
+        backing = THP;
+    }
+    return {base, size, backing};
+}
+
+void HugePageArena::bind(void *addr, size_t size) {
+    // 页面在首次访问时才分配，映射后立即绑定即可；绑定失败时内存仍可使用，只是不保证所在的节点
+    if (node_ >= 0) {
+        NumaTopology::get().bindMemory(addr, size, node_);
+    }
+}
+
+void *HugePageArena::allocate(size_t len, size_t align) {
+    std::lock_guard<std::mutex> locker(mtx_);
+    auto aligned = reinterpret_cast<char *>(
+        (reinterpret_cast<uintptr_t>(cursor_) + align - 1) & ~(uintptr_t)(align - 1));
+    if (!cursor_ || aligned + len > end_) {
+        // 当前区域的剩余部分不再使用，超出区域大小的分配单独映射
+        auto region = map(std::max(len, regionSize_));
+        regions_.push_back(region);
+        stats_.mapped[region.backing] += region.size;
+        cursor_ = region.base;
+        end_ = region.base + region.size;
+        aligned = cursor_;
+    }
+    cursor_ = aligned + len;
+    stats_.used += len;
+    return aligned;
+}
+
+HugePageArena::Stats HugePageArena::stats() const {
+    std::lock_guard<std::mutex> locker(mtx_);
+    return stats_;
+}
+
+const char *HugePageArena::backingName(Backing backing) {
+    static const char *names[BACKINGS] = {"hugetlb", "thp", "regular"};
+    return names[backing];
+}
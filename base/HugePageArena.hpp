@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+// 以大页为后备的内存区域分配器：依次尝试MAP_HUGETLB显式大页、以MADV_HUGEPAGE建议透明大页的
+// 2MB对齐区域，以及普通页，前一种不可用时回退到后一种
+// 分配的内存在arena销毁前一直有效，不单独释放；可在任意线程中调用
+class HugePageArena {
+public:
+    static const size_t HUGE_PAGE_SIZE = 2 << 20;
+
+    enum Backing { HUGETLB, THP, REGULAR, BACKINGS };
+
+    struct Stats {
+        // 各种方式映射的字节数
+        size_t mapped[BACKINGS] = {};
+        // 已分配出去的字节数
+        size_t used = 0;
+    };
+
+    // regionSize为每次映射的区域大小，向上取整到大页大小；
+    // node不小于0时每个区域都绑定到该NUMA节点（NumaTopology中的下标）
+    explicit HugePageArena(size_t regionSize = HUGE_PAGE_SIZE, int node = -1);
+    ~HugePageArena();
+
+    HugePageArena(const HugePageArena &) = delete;
+    HugePageArena &operator=(const HugePageArena &) = delete;
+
+    // 分配按align对齐的len字节，失败时抛出std::bad_alloc
+    void *allocate(size_t len, size_t align = 64);
+
+    Stats stats() const;
+
+    static const char *backingName(Backing backing);
+
+private:
+    struct Region {
+        char *base;
+        size_t size;
+        Backing backing;
+    };
+
+    // 映射至少size字节的新区域
+    Region map(size_t size);
+    void bind(void *addr, size_t size);
+
+    size_t regionSize_;
+    int node_;
+    mutable std::mutex mtx_;
+    std::vector<Region> regions_;
+    // 当前区域中下一次分配的位置与区域末尾
+    char *cursor_ = nullptr;
+    char *end_ = nullptr;
+    Stats stats_;
+    // 显式大页映射失败后不再尝试
+    bool hugetlbFailed_ = false;
+};
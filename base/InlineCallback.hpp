@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// 只可移动、从不分配内存的可调用对象，可调用对象必须能放入大小为Size的内联缓冲区，否则编译失败
+// 用于Channel等在热路径上反复调用、只设置一次的回调
+template <size_t Size>
+class InlineCallback {
+public:
+    InlineCallback() noexcept = default;
+
+    template <typename Func,
+              typename = typename std::enable_if<
+                  !std::is_same<typename std::decay<Func>::type, InlineCallback>::value>::type>
+    InlineCallback(Func &&func) { // NOLINT 允许由lambda隐式构造
+        using F = typename std::decay<Func>::type;
+        static_assert(sizeof(F) <= Size, "callable does not fit in InlineCallback");
+        static_assert(alignof(F) <= alignof(std::max_align_t), "callable is over-aligned");
+        static_assert(std::is_nothrow_move_constructible<F>::value,
+                      "callable must be nothrow move constructible");
+        new (buf_) F(std::forward<Func>(func));
+        ops_ = &opsFor<F>;
+    }
+
+    InlineCallback(InlineCallback &&other) noexcept { moveFrom(other); }
+
+    InlineCallback &operator=(InlineCallback &&other) noexcept {
+        if (this != &other) {
+            reset();
+            moveFrom(other);
+        }
+        return *this;
+    }
+
+    InlineCallback(const InlineCallback &) = delete;
+    InlineCallback &operator=(const InlineCallback &) = delete;
+
+    ~InlineCallback() { reset(); }
+
+    explicit operator bool() const { return ops_ != nullptr; }
+
+    void operator()() { ops_->invoke(buf_); }
+
+    void reset() {
+        if (ops_) {
+            ops_->destroy(buf_);
+            ops_ = nullptr;
+        }
+    }
+
+private:
+    struct Ops {
+        void (*invoke)(void *);
+        void (*move)(void *dst, void *src);
+        void (*destroy)(void *);
+    };
+
+    template <typename F>
+    static void invokeImpl(void *p) {
+        (*static_cast<F *>(p))();
+    }
+    template <typename F>
+    static void moveImpl(void *dst, void *src) {
+        new (dst) F(std::move(*static_cast<F *>(src)));
+        static_cast<F *>(src)->~F();
+    }
+    template <typename F>
+    static void destroyImpl(void *p) {
+        static_cast<F *>(p)->~F();
+    }
+
+    template <typename F>
+    static const Ops opsFor;
+
+    void moveFrom(InlineCallback &other) {
+        ops_ = other.ops_;
+        if (ops_) {
+            ops_->move(buf_, other.buf_);
+            other.ops_ = nullptr;
+        }
+    }
+
+    alignas(std::max_align_t) unsigned char buf_[Size];
+    const Ops *ops_ = nullptr;
+};
+
+template <size_t Size>
+template <typename F>
+const typename InlineCallback<Size>::Ops InlineCallback<Size>::opsFor = {
+    &InlineCallback::invokeImpl<F>, &InlineCallback::moveImpl<F>, &InlineCallback::destroyImpl<F>};
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+// 侵入式引用计数基类，计数与对象存放在一起，指针只占一个机器字
+// 计数降为0时delete对象；由对象池持有的对象池本身保留一份引用，因此不会被释放
+template <typename T>
+class RefCounted {
+public:
+    RefCounted() = default;
+    RefCounted(const RefCounted &) = delete;
+    RefCounted &operator=(const RefCounted &) = delete;
+
+    void Ref() const { refs_.fetch_add(1, std::memory_order_relaxed); }
+
+    void Unref() const {
+        if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete static_cast<const T *>(this);
+        }
+    }
+
+    int RefCount() const { return refs_.load(std::memory_order_relaxed); }
+
+protected:
+    ~RefCounted() = default;
+
+private:
+    mutable std::atomic<int> refs_{0};
+};
+
+template <typename T>
+class IntrusivePtr {
+public:
+    IntrusivePtr() noexcept = default;
+    IntrusivePtr(std::nullptr_t) noexcept {} // NOLINT
+
+    explicit IntrusivePtr(T *p) noexcept : ptr_(p) {
+        if (ptr_) {
+            ptr_->Ref();
+        }
+    }
+
+    IntrusivePtr(const IntrusivePtr &other) noexcept : IntrusivePtr(other.ptr_) {}
+
+    IntrusivePtr(IntrusivePtr &&other) noexcept : ptr_(other.ptr_) { other.ptr_ = nullptr; }
+
+    IntrusivePtr &operator=(IntrusivePtr other) noexcept {
+        std::swap(ptr_, other.ptr_);
+        return *this;
+    }
+
+    ~IntrusivePtr() {
+        if (ptr_) {
+            ptr_->Unref();
+        }
+    }
+
+    T *get() const { return ptr_; }
+    T &operator*() const { return *ptr_; }
+    T *operator->() const { return ptr_; }
+    explicit operator bool() const { return ptr_ != nullptr; }
+
+    void reset() { IntrusivePtr().swap(*this); }
+
+    // 放弃所持有的引用而不减少计数，用于对象池在自行析构对象前解除关联
+    T *detach() {
+        T *p = ptr_;
+        ptr_ = nullptr;
+        return p;
+    }
+    void swap(IntrusivePtr &other) noexcept { std::swap(ptr_, other.ptr_); }
+
+private:
+    T *ptr_ = nullptr;
+};
@@ -0,0 +1,108 @@
+#include "Numa.hpp"
+
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+// 读取sysfs文件的第一行，失败时返回空串
+static std::string readLine(const std::string &path) {
+    std::ifstream in(path);
+    std::string line;
+    std::getline(in, line);
+    return line;
+}
+
+const NumaTopology &NumaTopology::get() {
+    static const NumaTopology topology;
+    return topology;
+}
+
+NumaTopology::NumaTopology() {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+
+    for (int id : parseList(readLine("/sys/devices/system/node/online"))) {
+        Node node{id, {}};
+        auto path = "/sys/devices/system/node/node" + std::to_string(id) + "/cpulist";
+        for (int cpu : parseList(readLine(path))) {
+            if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) {
+                node.cpus.push_back(cpu);
+            }
+        }
+        // 没有可用CPU的节点（如纯内存节点或被cpuset排除的节点）不参与调度
+        if (!node.cpus.empty()) {
+            nodes_.push_back(std::move(node));
+        }
+    }
+    if (nodes_.empty()) {
+        Node node{0, {}};
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &allowed)) {
+                node.cpus.push_back(cpu);
+            }
+        }
+        if (node.cpus.empty()) {
+            node.cpus.push_back(0);
+        }
+        nodes_.push_back(std::move(node));
+    }
+}
+
+int NumaTopology::nodeOf(int cpu) const {
+    for (size_t i = 0; i < nodes_.size(); i++) {
+        auto &cpus = nodes_[i].cpus;
+        if (std::find(cpus.begin(), cpus.end(), cpu) != cpus.end()) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+bool NumaTopology::bindThread(const std::vector<int> &cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        CPU_SET(cpu, &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+bool NumaTopology::bindMemory(void *addr, size_t len, int index) const {
+    int id = nodes_[index].id;
+    unsigned long mask[16] = {};
+    const int bits = sizeof(unsigned long) * 8;
+    if (id < 0 || id >= bits * 16) {
+        return false;
+    }
+    mask[id / bits] |= 1UL << (id % bits);
+    // MPOL_PREFERRED在节点内存不足时回退到其他节点，而不是失败
+    return syscall(SYS_mbind, addr, len, MPOL_PREFERRED, mask, bits * 16, 0) == 0;
+}
+
+std::vector<int> NumaTopology::parseList(const std::string &list) {
+    std::vector<int> ret;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (item.empty()) {
+            continue;
+        }
+        char *end;
+        long first = strtol(item.c_str(), &end, 10);
+        long last = first;
+        if (*end == '-') {
+            last = strtol(end + 1, &end, 10);
+        }
+        for (long i = first; i <= last; i++) {
+            ret.push_back(static_cast<int>(i));
+        }
+    }
+    return ret;
+}
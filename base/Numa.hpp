@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// NUMA拓扑，从/sys/devices/system/node读取，不依赖libnuma
+// 只保留当前进程允许运行的CPU；sysfs不可用时视为一个包含全部可用CPU的节点
+class NumaTopology {
+public:
+    // 进程内只探测一次
+    static const NumaTopology &get();
+
+    int nodeCount() const { return static_cast<int>(nodes_.size()); }
+
+    // 第index个节点的sysfs编号及其CPU列表，index从0开始连续编号
+    int nodeId(int index) const { return nodes_[index].id; }
+    const std::vector<int> &cpus(int index) const { return nodes_[index].cpus; }
+
+    // 返回cpu所在节点的下标，未知时返回-1
+    int nodeOf(int cpu) const;
+
+    // 将当前线程绑定到给定的CPU集合
+    static bool bindThread(const std::vector<int> &cpus);
+
+    // 将[addr, addr + len)的内存优先分配在节点index上，页面在首次访问时才分配
+    bool bindMemory(void *addr, size_t len, int index) const;
+
+    // 解析sysfs中"0-3,8-11"格式的列表
+    static std::vector<int> parseList(const std::string &list);
+
+private:
+    NumaTopology();
+
+    struct Node {
+        int id;
+        std::vector<int> cpus;
+    };
+
+    std::vector<Node> nodes_;
+};
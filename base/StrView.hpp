@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// 不持有数据的字符串视图（C++14中没有std::string_view），指向的数据须在使用期间有效
+struct StrView {
+    const char *data = "";
+    size_t len = 0;
+
+    StrView() = default;
+    StrView(const char *d, size_t n) : data(d), len(n) {}
+    StrView(const char *s) : data(s), len(strlen(s)) {}
+
+    bool empty() const { return len == 0; }
+
+    std::string str() const { return std::string(data, len); }
+
+    bool operator==(StrView other) const {
+        return len == other.len && memcmp(data, other.data, len) == 0;
+    }
+    bool operator!=(StrView other) const { return !(*this == other); }
+
+    // 忽略ASCII大小写比较，用于请求头名称等
+    bool equalsIgnoreCase(StrView other) const {
+        if (len != other.len) {
+            return false;
+        }
+        for (size_t i = 0; i < len; i++) {
+            char a = data[i], b = other.data[i];
+            if (a != b && ((a | 0x20) != (b | 0x20) || (a | 0x20) < 'a' || (a | 0x20) > 'z')) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+// 供以StrView为键的无序容器使用（FNV-1a）
+struct StrViewHash {
+    size_t operator()(StrView s) const {
+        uint64_t h = 14695981039346656037ULL;
+        for (size_t i = 0; i < s.len; i++) {
+            h = (h ^ static_cast<unsigned char>(s.data[i])) * 1099511628211ULL;
+        }
+        return static_cast<size_t>(h);
+    }
+};
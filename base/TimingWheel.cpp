@@ -0,0 +1,194 @@
+#include "TimingWheel.hpp"
+
+#include <algorithm>
+
+#include "AllocStats.hpp"
+#include "Clock.hpp"
+
+const int TimingWheel::NIL;
+const int TimingWheel::DEFAULT_CAPACITY;
+
+TimingWheel::TimingWheel(int capacity, int tickMs) :
+    capacity_(capacity), tickMs_(tickMs), startMs_(CoarseClock::monotonicMs()),
+    slots_((1 << ROOT_BITS) + (LEVELS - 1) * (1 << LEVEL_BITS), NIL),
+    armed_(new std::atomic<uint64_t>[(capacity + 63) / 64]) {
+    assert(capacity > 0 && tickMs > 0);
+    for (int i = 0; i < (capacity + 63) / 64; i++) {
+        armed_[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+uint64_t TimingWheel::nowTick() const {
+    return (CoarseClock::monotonicMs() - startMs_) / tickMs_;
+}
+
+int TimingWheel::slotIndex(int level, uint64_t tick) {
+    if (level == 0) {
+        return static_cast<int>(tick & ((1 << ROOT_BITS) - 1));
+    }
+    int shift = ROOT_BITS + (level - 1) * LEVEL_BITS;
+    return (1 << ROOT_BITS) + (level - 1) * (1 << LEVEL_BITS)
+         + static_cast<int>((tick >> shift) & ((1 << LEVEL_BITS) - 1));
+}
+
+bool TimingWheel::setArmed(int id) {
+    auto bit = 1ULL << (id % 64);
+    if (armed_[id / 64].fetch_or(bit, std::memory_order_acq_rel) & bit) {
+        return false;
+    }
+    armedCount_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool TimingWheel::clearArmed(int id) {
+    auto bit = 1ULL << (id % 64);
+    if (!(armed_[id / 64].fetch_and(~bit, std::memory_order_acq_rel) & bit)) {
+        return false;
+    }
+    armedCount_.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+void TimingWheel::insert(int id, uint64_t earliest) {
+    auto &node = nodes_[id];
+    assert(node.slot == NIL && earliest >= current_);
+    uint64_t expires = std::max(node.expires, earliest);
+    uint64_t delta = expires - current_;
+    int level = 0;
+    while (level < LEVELS - 1 && delta >= (1ULL << (ROOT_BITS + level * LEVEL_BITS))) {
+        level++;
+    }
+    const uint64_t range = 1ULL << (ROOT_BITS + (LEVELS - 1) * LEVEL_BITS);
+    if (delta >= range) {
+        // 超出时间轮范围，先放在最高层的最远处，到时再重新放入
+        expires = current_ + range - 1;
+    }
+    node.scheduled = expires;
+    node.slot = slotIndex(level, expires);
+    node.prev = NIL;
+    node.next = slots_[node.slot];
+    if (node.next != NIL) {
+        nodes_[node.next].prev = id;
+    }
+    slots_[node.slot] = id;
+    ++linked_;
+}
+
+void TimingWheel::unlink(int id) {
+    auto &node = nodes_[id];
+    assert(node.slot != NIL);
+    if (node.prev != NIL) {
+        nodes_[node.prev].next = node.next;
+    } else {
+        slots_[node.slot] = node.next;
+    }
+    if (node.next != NIL) {
+        nodes_[node.next].prev = node.prev;
+    }
+    node.prev = node.next = node.slot = NIL;
+    --linked_;
+}
+
+void TimingWheel::cascade(int level) {
+    int slot = slotIndex(level, current_);
+    int id;
+    while ((id = slots_[slot]) != NIL) {
+        unlink(id);
+        if (isArmed(id)) {
+            // 级联在处理current_所在的槽之前进行，恰好在current_到期的节点放入该槽，不推迟一个刻度
+            insert(id, current_);
+        }
+    }
+}
+
+void TimingWheel::expire(int slot) {
+    int id;
+    while ((id = slots_[slot]) != NIL) {
+        unlink(id);
+        auto &node = nodes_[id];
+        if (!isArmed(id)) {
+            continue; // 已取消，回收节点
+        }
+        if (node.expires > current_) {
+            insert(id, current_ + 1); // 期间被刷新过
+            continue;
+        }
+        // 回调中可能重新注册同一id，先取出回调
+        auto cb = std::move(node.cb);
+        if (clearArmed(id) && cb) {
+            cb();
+        }
+    }
+}
+
+void TimingWheel::add(int id, int timeOut, TimeoutCallBack cb) {
+    assert(id >= 0 && id < capacity_);
+    ALLOC_SCOPE(TIMER);
+    if (id >= static_cast<int>(nodes_.size())) {
+        nodes_.resize(std::min(capacity_, std::max(id + 1, static_cast<int>(nodes_.size()) * 2)));
+    }
+    auto &node = nodes_[id];
+    node.cb = std::move(cb);
+    node.expires = nowTick() + (std::max(timeOut, 0) + tickMs_ - 1) / tickMs_;
+    setArmed(id);
+    // 已过期的节点放入下一个刻度，当前刻度的槽已经处理过
+    if (node.slot == NIL) {
+        insert(id, current_ + 1);
+    } else if (node.expires < node.scheduled) {
+        unlink(id);
+        insert(id, current_ + 1);
+    }
+}
+
+void TimingWheel::disable(int id) {
+    assert(id >= 0 && id < capacity_);
+    clearArmed(id);
+}
+
+int TimingWheel::getNextTick() {
+    auto target = nowTick();
+    while (current_ < target) {
+        if (linked_ == 0) {
+            current_ = target;
+            break;
+        }
+        ++current_;
+        if ((current_ & ((1 << ROOT_BITS) - 1)) == 0) {
+            // 低层转完一圈，自高向低将上层当前槽中的节点放入下层
+            int level = 1;
+            while (level < LEVELS - 1
+                   && ((current_ >> (ROOT_BITS + (level - 1) * LEVEL_BITS))
+                       & ((1 << LEVEL_BITS) - 1))
+                          == 0) {
+                level++;
+            }
+            for (; level >= 1; level--) {
+                cascade(level);
+            }
+        }
+        expire(slotIndex(0, current_));
+    }
+    if (linked_ == 0) {
+        return -1;
+    }
+    // 第0层中最近的非空槽，没有时为第0层下一次转完一圈的时刻
+    uint64_t next = ((current_ >> ROOT_BITS) + 1) << ROOT_BITS;
+    for (uint64_t tick = current_ + 1; tick < next; tick++) {
+        if (slots_[slotIndex(0, tick)] != NIL) {
+            next = tick;
+            break;
+        }
+    }
+    auto ms = startMs_ + static_cast<int64_t>(next * tickMs_) - CoarseClock::monotonicMs();
+    return static_cast<int>(std::max<int64_t>(ms, 1));
+}
+
+void TimingWheel::clear() {
+    for (int i = 0; i < static_cast<int>(nodes_.size()); i++) {
+        if (nodes_[i].slot != NIL) {
+            unlink(i);
+        }
+        nodes_[i].cb.reset();
+        clearArmed(i);
+    }
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "InlineCallback.hpp"
+
+// 回调存放在节点内，注册与到期均不分配内存
+using TimeoutCallBack = InlineCallback<32>;
+
+// 分层时间轮，以id（fd）为下标管理定时器
+// 第0层256个槽，其余3层各64个槽，刻度为tickMs时可覆盖tickMs * 2^26的超时时间；
+// 添加、刷新与取消均为O(1)：刷新只推迟到期时间而不移动节点，节点所在槽到期时再按新的到期时间重新放入；
+// 取消只清除以id为下标的原子位图中的对应位，节点在所在槽到期时回收
+// 时间取自CoarseClock，由所属IO线程每轮循环更新；add与getNextTick只能在所属IO线程中调用，
+// disable可在任意线程中调用
+class TimingWheel {
+public:
+    // capacity为id的上限，节点按实际用到的最大id逐步分配
+    static const int DEFAULT_CAPACITY = 1 << 20;
+
+    explicit TimingWheel(int capacity = DEFAULT_CAPACITY, int tickMs = 10);
+
+    TimingWheel(const TimingWheel &) = delete;
+    TimingWheel &operator=(const TimingWheel &) = delete;
+
+    // 注册定时器，id已注册时更新其超时时间与回调（即刷新）
+    void add(int id, int timeOut, TimeoutCallBack cb);
+
+    // 取消定时器
+    void disable(int id);
+
+    // 处理已到期的定时器，返回下一次需要处理的时间距当前时间的毫秒数，没有定时器时返回-1
+    int getNextTick();
+
+    // 处于有效状态的定时器数
+    int size() const { return armedCount_.load(std::memory_order_relaxed); }
+
+    void clear();
+
+    // 每个节点占用的字节数，用于估算每个连接的内存占用
+    static size_t nodeBytes() { return sizeof(Node); }
+
+private:
+    static const int LEVELS = 4;
+    static const int ROOT_BITS = 8;
+    static const int LEVEL_BITS = 6;
+    static const int NIL = -1;
+
+    struct Node {
+        // 实际到期的刻度
+        uint64_t expires = 0;
+        // 放入当前槽时使用的到期刻度，expires不早于它时无需移动节点
+        uint64_t scheduled = 0;
+        int prev = NIL;
+        int next = NIL;
+        // 所在槽在slots_中的下标，不在任何槽中时为NIL
+        int slot = NIL;
+        TimeoutCallBack cb;
+    };
+
+    uint64_t nowTick() const;
+
+    static int slotIndex(int level, uint64_t tick);
+
+    // 按节点的expires放入对应的层与槽，早于earliest的按earliest放入
+    void insert(int id, uint64_t earliest);
+    void unlink(int id);
+    // 将一个槽中的节点重新按到期时间放入较低的层
+    void cascade(int level);
+    void expire(int slot);
+
+    bool isArmed(int id) const {
+        return armed_[id / 64].load(std::memory_order_acquire) & (1ULL << (id % 64));
+    }
+    bool setArmed(int id);
+    // 清除id对应的位，返回清除前是否有效
+    bool clearArmed(int id);
+
+    int capacity_;
+    int tickMs_;
+    // 创建时单调时钟的毫秒数，刻度从此开始计算
+    int64_t startMs_;
+    // 已处理到的刻度
+    uint64_t current_ = 0;
+    // 仍在槽中的节点数（包括已取消但尚未回收的）
+    int linked_ = 0;
+    // 以id为下标，按用到的最大id增长
+    std::vector<Node> nodes_;
+    // 各槽链表的头节点，依次为第0层到第3层
+    std::vector<int> slots_;
+    std::unique_ptr<std::atomic<uint64_t>[]> armed_;
+    std::atomic<int> armedCount_{0};
+};
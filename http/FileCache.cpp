@@ -0,0 +1,110 @@
+#include "FileCache.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+
+#include "../base/AllocStats.hpp"
+
+const size_t FileCache::MAX_FILE_SIZE;
+const size_t FileCache::MAX_BYTES;
+
+FileCache &FileCache::get() {
+    static FileCache cache;
+    return cache;
+}
+
+bool FileCache::fresh(const Entry &entry, const struct stat &st) {
+    return entry.size == st.st_size && entry.mtime.tv_sec == st.st_mtim.tv_sec
+        && entry.mtime.tv_nsec == st.st_mtim.tv_nsec;
+}
+
+const char *FileCache::lookup(const char *path, const struct stat &st) {
+    if (st.st_size <= 0 || static_cast<size_t>(st.st_size) > MAX_FILE_SIZE) {
+        return nullptr;
+    }
+    {
+        std::shared_lock<std::shared_timed_mutex> locker(mtx_);
+        auto it = entries_.find(path);
+        if (it != entries_.end() && it->second.data && fresh(it->second, st)) {
+            hits_.fetch_add(1, std::memory_order_relaxed);
+            return it->second.data;
+        }
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        if (it != entries_.end() && !it->second.data) {
+            return nullptr;
+        }
+    }
+    // 每个文件只在首次读入时分配表项
+    ALLOC_ALLOW();
+    std::unique_lock<std::shared_timed_mutex> locker(mtx_);
+    // 其他线程可能已经读入或已发现文件被修改
+    auto it = entries_.find(path);
+    if (it != entries_.end()) {
+        if (it->second.data && fresh(it->second, st)) {
+            return it->second.data;
+        }
+        if (it->second.data) {
+            it->second.data = nullptr;
+            changed_++;
+        }
+        return nullptr;
+    }
+    if (bytes_ + st.st_size > MAX_BYTES) {
+        return nullptr;
+    }
+    size_t before = bytes_;
+    auto data = load(path, st);
+    if (!data && bytes_ == before) {
+        // 打开失败，没有占用空间
+        return nullptr;
+    }
+    // 读取期间被截断的文件同样视为已修改，不再重复读入
+    if (!data) {
+        changed_++;
+    }
+    StrView key(path);
+    auto copy = static_cast<char *>(arena_.allocate(key.len, 1));
+    memcpy(copy, key.data, key.len);
+    entries_.emplace(StrView(copy, key.len), Entry{data, st.st_size, st.st_mtim});
+    return data;
+}
+
+const char *FileCache::load(const char *path, const struct stat &st) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+    auto data = static_cast<char *>(arena_.allocate(st.st_size));
+    bytes_ += st.st_size;
+    off_t off = 0;
+    while (off < st.st_size) {
+        ssize_t n = pread(fd, data + off, st.st_size - off, off);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        off += n;
+    }
+    close(fd);
+    // 读取期间文件被截断，不缓存，已分配的空间不再使用
+    return off == st.st_size ? data : nullptr;
+}
+
+FileCache::Stats FileCache::stats() const {
+    Stats ret;
+    ret.hits = hits_.load(std::memory_order_relaxed);
+    ret.misses = misses_.load(std::memory_order_relaxed);
+    {
+        std::shared_lock<std::shared_timed_mutex> locker(mtx_);
+        ret.files = entries_.size() - changed_;
+        ret.changed = changed_;
+        ret.bytes = bytes_;
+    }
+    ret.arena = arena_.stats();
+    return ret;
+}
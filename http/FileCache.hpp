@@ -0,0 +1,67 @@
+#pragma once
+
+#include <sys/stat.h>
+#include <atomic>
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+#include "../base/HugePageArena.hpp"
+#include "../base/StrView.hpp"
+
+// 静态文件内容的进程级缓存，内容保存在大页arena中，所有IO线程共享
+// 以文件路径为键，用调用者stat得到的大小与修改时间判断是否过期；只追加不淘汰，总量达到上限后不再缓存新内容
+// 缓存后被修改过的文件不再缓存：旧内容可能还有响应在发送，既不能原地覆盖，也不为新内容另分配空间，
+// 此后由调用者mmap，因此arena的用量只随不同文件的数量增长，不随文件的修改次数增长
+class FileCache {
+public:
+    // 超过此大小的文件不缓存，仍由调用者mmap
+    static const size_t MAX_FILE_SIZE = 1 << 20;
+    // 缓存内容（包括已过期文件的旧内容）的总字节数上限
+    static const size_t MAX_BYTES = 64 << 20;
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        size_t files = 0;
+        // 缓存后被修改、不再缓存的文件数
+        size_t changed = 0;
+        size_t bytes = 0;
+        HugePageArena::Stats arena;
+    };
+
+    static FileCache &get();
+
+    FileCache(const FileCache &) = delete;
+    FileCache &operator=(const FileCache &) = delete;
+
+    // 返回文件内容，st为调用者刚刚对path做的stat；文件不适合缓存或读取失败时返回nullptr
+    // 返回的内容在进程退出前一直有效；命中时不分配内存
+    const char *lookup(const char *path, const struct stat &st);
+
+    Stats stats() const;
+
+private:
+    struct Entry {
+        // 为空表示文件在缓存后被修改过，不再缓存
+        const char *data;
+        off_t size;
+        struct timespec mtime;
+    };
+
+    FileCache() = default;
+
+    static bool fresh(const Entry &entry, const struct stat &st);
+    // 将文件读入arena，失败时返回nullptr
+    const char *load(const char *path, const struct stat &st);
+
+    mutable std::shared_timed_mutex mtx_;
+    // 键指向arena中保存的路径副本，查找时可直接以调用者的路径构造
+    std::unordered_map<StrView, Entry, StrViewHash> entries_;
+    size_t bytes_ = 0;
+    size_t changed_ = 0;
+    HugePageArena arena_;
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+};
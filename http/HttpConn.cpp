@@ -1,6 +1,8 @@
+#include <arpa/inet.h>
 #include <unistd.h>
 #include "HttpConn.hpp"
 #include "../log/log.h"
+#include "../base/AllocStats.hpp"
 
 const char *HttpConn::srcDir;
 std::atomic<int> HttpConn::userCount;
@@ -8,30 +10,43 @@ bool HttpConn::isET;
 
 HttpConn::HttpConn() {
     fd_ = -1;
-    addr_ = {0};
+    addr_ = {};
     isClose_ = true;
+    served_ = false;
+    readPaused_ = false;
 };
 
 HttpConn::~HttpConn(){};
 
-void HttpConn::init(int fd, const sockaddr_in &addr) {
+void HttpConn::init(int fd, const sockaddr_storage &addr) {
     assert(fd > 0);
     userCount++;
     addr_ = addr;
     fd_ = fd;
     writeBuff_.RetrieveAll();
     readBuff_.RetrieveAll();
+    fileIov_.iov_len = 0;
     isClose_ = false;
+    served_ = false;
+    state_.store(0, std::memory_order_relaxed);
     LOG_INFO("Client[%d](%s:%d) in, userCount:%d", fd_, GetIP(), GetPort(), (int)userCount);
 }
 
 void HttpConn::Close() {
-    response_.UnmapFile();
+    // 关闭的连接在槽中保留到fd复用，其缓冲区与字符串先行归还
+    response_.Release();
+    request_.Release();
+    readBuff_.RetrieveAll();
+    readBuff_.Shrink();
+    writeBuff_.RetrieveAll();
+    writeBuff_.Shrink();
+    fileIov_.iov_len = 0;
     if (!isClose_) {
         isClose_ = true;
         userCount--;
-        close(fd_);
         LOG_INFO("Client[%d](%s:%d) quit, UserCount:%d", fd_, GetIP(), GetPort(), (int)userCount);
+        // 连接对象会在fd复用时被重新初始化，关闭fd必须是最后一步
+        close(fd_);
     }
 }
 
@@ -39,85 +54,114 @@ int HttpConn::GetFd() const {
     return fd_;
 };
 
-sockaddr_in HttpConn::GetAddr() const {
+const sockaddr_storage &HttpConn::GetAddr() const {
     return addr_;
 }
 
 const char *HttpConn::GetIP() const {
-    return inet_ntoa(addr_.sin_addr);
+    static thread_local char ip[INET6_ADDRSTRLEN];
+    if (addr_.ss_family == AF_INET) {
+        return inet_ntop(AF_INET, &reinterpret_cast<const sockaddr_in *>(&addr_)->sin_addr, ip,
+                         sizeof(ip));
+    }
+    if (addr_.ss_family == AF_INET6) {
+        return inet_ntop(AF_INET6, &reinterpret_cast<const sockaddr_in6 *>(&addr_)->sin6_addr, ip,
+                         sizeof(ip));
+    }
+    return "unix";
 }
 
 int HttpConn::GetPort() const {
-    return addr_.sin_port;
+    if (addr_.ss_family == AF_INET) {
+        return ntohs(reinterpret_cast<const sockaddr_in *>(&addr_)->sin_port);
+    }
+    if (addr_.ss_family == AF_INET6) {
+        return ntohs(reinterpret_cast<const sockaddr_in6 *>(&addr_)->sin6_port);
+    }
+    return 0;
 }
 
-ssize_t HttpConn::read(int *saveErrno) {
+ssize_t HttpConn::read(int *saveErrno, size_t limit) {
     ssize_t len = -1;
+    readPaused_ = false;
     do {
         len = readBuff_.ReadFd(fd_, saveErrno);
         if (len <= 0) {
             break;
         }
+        if (readBuff_.ReadableBytes() >= limit) {
+            readPaused_ = true;
+            break;
+        }
     } while (isET);
     return len;
 }
 
 ssize_t HttpConn::write(int *saveErrno) {
+    // 发送响应只写出已准备好的数据，不应分配内存
+    ALLOC_PHASE(WRITE);
+    ALLOC_EXPECT_NONE("HttpConn::write");
     ssize_t len = -1;
     do {
-        len = writev(fd_, iov_, iovCnt_);
+        // 响应头直接从写缓冲区的各个块发送，文件内容接在其后
+        len = writeBuff_.WriteFd(fd_, saveErrno, &fileIov_);
         if (len <= 0) {
             *saveErrno = errno;
             break;
         }
-        if (iov_[0].iov_len + iov_[1].iov_len == 0) {
+        LOG_DEBUG("write %d bytes to client[%d]", len, fd_)
+        if (ToWriteBytes() == 0) {
             break;
         } /* 传输结束 */
-        else if (static_cast<size_t>(len) > iov_[0].iov_len) {
-            iov_[1].iov_base = (uint8_t *)iov_[1].iov_base + (len - iov_[0].iov_len);
-            iov_[1].iov_len -= (len - iov_[0].iov_len);
-            if (iov_[0].iov_len) {
-                writeBuff_.RetrieveAll();
-                iov_[0].iov_len = 0;
-            }
-        } else {
-            iov_[0].iov_base = (uint8_t *)iov_[0].iov_base + len;
-            iov_[0].iov_len -= len;
-            writeBuff_.Retrieve(len);
-        }
-        LOG_DEBUG("write %d bytes to client[%d]", len, fd_)
     } while (isET || ToWriteBytes() > 10240);
     return len;
 }
 
 bool HttpConn::process() {
-    request_.Init();
+    // 解析与生成响应均使用连接自身的缓冲区，与write一起构成请求处理中不分配内存的范围
+    ALLOC_PHASE(PARSE);
+    ALLOC_EXPECT_NONE("HttpConn::process");
     if (readBuff_.ReadableBytes() <= 0) {
+        // 请求已处理完，keep-alive空闲期间不持有缓冲区与请求数据
+        readBuff_.Shrink();
+        writeBuff_.Shrink();
+        request_.Release();
+        response_.Release();
         return false;
     } else if (request_.parse(readBuff_)) {
-        LOG_DEBUG("%s", request_.path().c_str());
+        LOG_DEBUG("%.*s", (int)request_.path().len, request_.path().data);
         response_.Init(srcDir, request_.path(), request_.IsKeepAlive(), 200);
-        // response_.Init(srcDir, request_.path(), false, 200);
+        // 请求的视图指向读缓冲区，路径已复制到响应中，取走请求后流水线中的下一个请求从头开始解析
+        readBuff_.Retrieve(request_.Length());
     } else {
         if (request_.httpCode
             == HttpRequest::NO_REQUEST) { // 如果读取到的不是完整请求，返回继续读取数据
             return false;
         }
         response_.Init(srcDir, request_.path(), false, 400);
+        // 出错后连接在发送响应后关闭，其余数据不再解析
+        readBuff_.RetrieveAll();
     }
 
+    ALLOC_PHASE(HANDLE);
+    served_ = true;
     response_.MakeResponse(writeBuff_);
-    /* 响应头 */
-    iov_[0].iov_base = const_cast<char *>(writeBuff_.Peek());
-    iov_[0].iov_len = writeBuff_.ReadableBytes();
-    iovCnt_ = 1;
-
     /* 文件 */
+    fileIov_.iov_len = 0;
     if (response_.FileLen() > 0 && response_.File()) {
-        iov_[1].iov_base = response_.File();
-        iov_[1].iov_len = response_.FileLen();
-        iovCnt_ = 2;
+        fileIov_.iov_base = response_.File();
+        fileIov_.iov_len = response_.FileLen();
     }
-    LOG_DEBUG("filesize:%d, %d  to %d", response_.FileLen(), iovCnt_, ToWriteBytes());
+    LOG_DEBUG("filesize:%d to %d", response_.FileLen(), ToWriteBytes());
     return true;
-}
\ No newline at end of file
+}
+
+HttpConn::Deadline HttpConn::CurrentDeadline() const {
+    if (ToWriteBytes() > 0) {
+        return WRITE_TIMEOUT;
+    }
+    if (readBuff_.ReadableBytes() == 0) {
+        return served_ ? IDLE_TIMEOUT : HEADER_TIMEOUT;
+    }
+    return request_.state() == HttpRequest::BODY ? BODY_TIMEOUT : HEADER_TIMEOUT;
+}
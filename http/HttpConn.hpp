@@ -2,57 +2,125 @@
 
 #include <sys/types.h>
 #include <sys/uio.h>   // readv/writev
-#include <arpa/inet.h> // sockaddr_in
+#include <sys/socket.h> // sockaddr_storage
+#include <cstdint>     // SIZE_MAX
 #include <cstdlib>     // atoi()
 #include <cerrno>
 #include <atomic>
 #include "HttpRequest.hpp"
 #include "HttpResponse.hpp"
+#include "../base/IntrusivePtr.hpp"
 
-class HttpConn {
+class HttpConn : public RefCounted<HttpConn> {
 public:
     HttpConn();
 
     ~HttpConn();
 
-    void init(int sockFd, const sockaddr_in &addr);
+    // addr为accept得到的对端地址，可以是IPv4、IPv6或Unix域套接字地址
+    void init(int sockFd, const sockaddr_storage &addr);
 
-    ssize_t read(int *saveErrno);
+    // 读缓冲区中的数据达到limit字节时暂停读取，待已读入的请求处理后再继续
+    ssize_t read(int *saveErrno, size_t limit = SIZE_MAX);
+
+    // 上一次read是否因达到上限而在读完之前停止
+    bool ReadPaused() const { return readPaused_; }
 
     ssize_t write(int *saveErrno);
 
     void Close();
 
+    bool IsClosed() const { return isClose_; }
+
     int GetFd() const;
 
+    // Unix域套接字的连接返回0
     int GetPort() const;
 
+    // 返回的字符串在本线程下一次调用前有效，Unix域套接字的连接返回"unix"
     const char *GetIP() const;
 
-    sockaddr_in GetAddr() const;
+    const sockaddr_storage &GetAddr() const;
 
+    // 处理读缓冲区中的请求，没有可处理的数据时释放缓冲区、请求与响应占用的内存后返回false
     bool process();
 
-    int ToWriteBytes() { return iov_[0].iov_len + iov_[1].iov_len; }
+    int ToWriteBytes() const { return writeBuff_.ReadableBytes() + fileIov_.iov_len; }
+
+    size_t ToReadBytes() const { return readBuff_.ReadableBytes(); }
 
     bool IsKeepAlive() const { return request_.IsKeepAlive(); }
 
+    // 连接所有权与待处理事件标记：连接只注册一次边缘触发事件，
+    // 由拿到BUSY标记的线程独占处理，处理期间到达的事件记录在标记中由其继续处理
+    // RESUME不由事件产生，表示交接到其他线程后继续处理缓冲区中的数据
+    enum Event : uint32_t { BUSY = 1, READABLE = 2, WRITABLE = 4, HANGUP = 8, RESUME = 16 };
+
+    // 记录事件，返回true表示调用者获得了连接的所有权，需要负责处理
+    bool MarkEvents(uint32_t ev) {
+        return !(state_.fetch_or(ev | BUSY, std::memory_order_acq_rel) & BUSY);
+    }
+
+    // 由所有者调用，取出并清除待处理的事件
+    uint32_t TakeEvents() {
+        return state_.exchange(BUSY, std::memory_order_acq_rel) & ~static_cast<uint32_t>(BUSY);
+    }
+
+    // 由所有者调用，期间没有新事件时释放所有权并返回true，否则需继续处理
+    bool Release() {
+        uint32_t expected = BUSY;
+        return state_.compare_exchange_strong(expected, 0, std::memory_order_acq_rel);
+    }
+
+    // 连接当前适用的超时类别：等待完整的请求头、等待请求体、keep-alive空闲、等待发送进展
+    enum Deadline : uint32_t { HEADER_TIMEOUT, BODY_TIMEOUT, IDLE_TIMEOUT, WRITE_TIMEOUT, DEADLINES };
+
+    // 由所有者按缓冲区与解析状态判断当前的超时类别
+    Deadline CurrentDeadline() const;
+
+    // 到期时间（毫秒）与类别合并存放，所有者写入，IO线程的定时器回调读取
+    // 与定时器时间的读写均为顺序一致，所有者与IO线程之间至少有一方能看到对方的更新
+    void SetDeadline(Deadline kind, int64_t ms) { deadline_.store(ms << 2 | kind); }
+
+    int64_t GetDeadline(Deadline *kind) const {
+        auto value = deadline_.load();
+        *kind = static_cast<Deadline>(value & 3);
+        return value >> 2;
+    }
+
+    // 定时器设置的触发时间（毫秒），IO线程写入，所有者在提前到期时间时读取
+    void SetTimerAt(int64_t ms) { timerAt_.store(ms); }
+    int64_t GetTimerAt() const { return timerAt_.load(); }
+
+    // 是否正有线程持有连接的所有权
+    bool IsBusy() const { return state_.load(std::memory_order_acquire) & BUSY; }
+
     static bool isET;
     static const char *srcDir;
     static std::atomic<int> userCount;
 
 private:
+    // 每次事件都会访问的字段集中放在对象开头，与缓冲区等较大的成员隔开
+    std::atomic<uint32_t> state_{0};
     int fd_;
-    struct sockaddr_in addr_;
-
     bool isClose_;
+    // 尚未发送的文件内容，响应头在写缓冲区中
+    struct iovec fileIov_;
+    char pad_[64];
 
-    int iovCnt_;
-    struct iovec iov_[2];
+    std::atomic<int64_t> deadline_{0};
+    std::atomic<int64_t> timerAt_{0};
+    // 是否已完成过请求，之前没有数据时为等待首个请求头，之后为keep-alive空闲
+    bool served_;
+    bool readPaused_;
+
+    sockaddr_storage addr_;
 
     Buffer readBuff_;  // 读缓冲区
     Buffer writeBuff_; // 写缓冲区
 
     HttpRequest request_;
     HttpResponse response_;
-};
\ No newline at end of file
+};
+
+typedef IntrusivePtr<HttpConn> SP_HttpConn;
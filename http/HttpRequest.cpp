@@ -1,122 +1,339 @@
 #include "HttpRequest.hpp"
 #include "../log/log.h"
+#include "../base/AllocStats.hpp"
 
-#include <regex>
-#include <unordered_map>
-#include <unordered_set>
+#include <algorithm>
+#include <cstring>
 
-const unordered_set<string> HttpRequest::DEFAULT_HTML{
-    "/index", "/register", "/login", "/welcome", "/video", "/picture",
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+const size_t HttpRequest::MAX_LINE;
+const size_t HttpRequest::MAX_HEADER_SIZE;
+const int HttpRequest::MAX_HEADERS;
+
+namespace {
+
+// 不带扩展名的默认页面及其对应的文件
+const struct {
+    StrView path;
+    const char *file;
+} DEFAULT_HTML[] = {
+    {"/", "/index.html"},          {"/index", "/index.html"},     {"/register", "/register.html"},
+    {"/login", "/login.html"},     {"/welcome", "/welcome.html"}, {"/video", "/video.html"},
+    {"/picture", "/picture.html"},
+};
+
+// 行尾与非法字符：除HT以外的控制字符及DEL
+inline bool isControl(unsigned char ch) {
+    return (ch < 0x20 && ch != '\t') || ch == 0x7f;
+}
+
+// 返回[p, end)中第一个控制字符的位置，没有时返回end
+const char *findControlScalar(const char *p, const char *end) {
+    while (p < end && !isControl(static_cast<unsigned char>(*p))) {
+        p++;
+    }
+    return p;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// 一次比较16字节，以字符范围描述控制字符
+__attribute__((target("sse4.2"))) const char *findControlSse42(const char *p, const char *end) {
+    alignas(16) static const char ranges[16] = {0x00, 0x08, 0x0a, 0x1f, 0x7f, 0x7f};
+    const __m128i r = _mm_load_si128(reinterpret_cast<const __m128i *>(ranges));
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        int idx = _mm_cmpestri(r, 6, v, 16, _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_LEAST_SIGNIFICANT);
+        if (idx != 16) {
+            return p + idx;
+        }
+        p += 16;
+    }
+    return findControlScalar(p, end);
+}
+
+// 一次比较32字节
+__attribute__((target("avx2"))) const char *findControlAvx2(const char *p, const char *end) {
+    const __m256i limit = _mm256_set1_epi8(0x1f);
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i del = _mm256_set1_epi8(0x7f);
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        // 无符号比较v <= 0x1f，排除HT，加上DEL
+        __m256i ctl = _mm256_cmpeq_epi8(_mm256_min_epu8(v, limit), v);
+        ctl = _mm256_andnot_si256(_mm256_cmpeq_epi8(v, tab), ctl);
+        ctl = _mm256_or_si256(ctl, _mm256_cmpeq_epi8(v, del));
+        auto mask = static_cast<unsigned>(_mm256_movemask_epi8(ctl));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+    return findControlScalar(p, end);
+}
+
+#endif
+
+struct ScanImpl {
+    const char *(*find)(const char *, const char *);
+    const char *name;
 };
 
+ScanImpl selectScanner() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return {findControlAvx2, "avx2"};
+    }
+    if (__builtin_cpu_supports("sse4.2")) {
+        return {findControlSse42, "sse4.2"};
+    }
+#endif
+    return {findControlScalar, "scalar"};
+}
+
+const ScanImpl scanner = selectScanner();
+
+// 去掉两端的空格与HT
+void trim(const char *base, size_t *begin, size_t *end) {
+    while (*begin < *end && (base[*begin] == ' ' || base[*begin] == '\t')) {
+        ++*begin;
+    }
+    while (*end > *begin && (base[*end - 1] == ' ' || base[*end - 1] == '\t')) {
+        --*end;
+    }
+}
+
+} // namespace
+
 void HttpRequest::Init() {
-    method_ = path_ = version_ = body_ = "";
     state_ = REQUEST_LINE;
     httpCode = NO_REQUEST;
-    header_.clear();
+    base_ = "";
+    lineStart_ = scanned_ = 0;
+    headerLen_ = contentLength_ = length_ = 0;
+    method_ = target_ = version_ = Field{0, 0};
+    mappedPath_ = nullptr;
+    http11_ = keepAlive_ = hasContentLength_ = false;
+    headerCount_ = 0;
 }
 
-bool HttpRequest::IsKeepAlive() const {
-    if (header_.count("Connection") == 1) {
-        return header_.find("Connection")->second == "keep-alive" && version_ == "1.1";
+void HttpRequest::Release() {
+    Init();
+}
+
+const char *HttpRequest::Scanner() {
+    return scanner.name;
+}
+
+HttpRequest::ScanFunc HttpRequest::ScannerImpl(const char *name) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (strcmp(name, "avx2") == 0) {
+        return __builtin_cpu_supports("avx2") ? findControlAvx2 : nullptr;
     }
+    if (strcmp(name, "sse4.2") == 0) {
+        return __builtin_cpu_supports("sse4.2") ? findControlSse42 : nullptr;
+    }
+#endif
+    return strcmp(name, "scalar") == 0 ? findControlScalar : nullptr;
+}
+
+bool HttpRequest::IsKeepAlive() const {
+    return keepAlive_ && http11_;
+}
+
+bool HttpRequest::Fail_(const char *reason) {
+    LOG_WARN("bad request: %s", reason)
+    httpCode = BAD_REQUEST;
     return false;
 }
 
 bool HttpRequest::parse(Buffer &buff) {
-    const char CRLF[] = "\r\n";
-    if (buff.ReadableBytes() <= 0) {
-        httpCode = NO_REQUEST;
+    ALLOC_SCOPE(REQUEST);
+    if (state_ == FINISH) {
+        // 上一个请求已处理完，其数据已被取走
+        Init();
+    }
+    if (httpCode == BAD_REQUEST) {
         return false;
     }
-    while (buff.ReadableBytes() && state_ != FINISH) {
-        const char *lineEnd = std::search(buff.Peek(), buff.BeginWriteConst(), CRLF, CRLF + 2);
-        if (lineEnd == buff.BeginWriteConst()) {
-            httpCode = NO_REQUEST;
-            return false;
-        }
-        std::string line(buff.Peek(), lineEnd);
-        switch (state_) {
-        case REQUEST_LINE:
-            if (!ParseRequestLine_(line)) {
-                return false;
+    const size_t readable = buff.ReadableBytes();
+    httpCode = NO_REQUEST;
+    // 等待请求体时只需比较长度，不必合并缓冲区
+    if (state_ == BODY && readable < headerLen_ + contentLength_) {
+        return false;
+    }
+    if (readable == 0) {
+        return false;
+    }
+    // 直接扫描第一个块中的连续数据，行跨越块的边界时才合并
+    const size_t maxWindow = std::min(readable, MAX_HEADER_SIZE);
+    size_t window = std::min(buff.ContiguousBytes(), maxWindow);
+    base_ = buff.Peek();
+    while (state_ == REQUEST_LINE || state_ == HEADERS) {
+        const char *limit = base_ + window;
+        const char *p = scanner.find(base_ + scanned_, limit);
+        if (p == limit || (*p == '\r' && p + 1 == limit)) {
+            // 行尚不完整
+            scanned_ = p - base_;
+            if (scanned_ - lineStart_ > MAX_LINE) {
+                return Fail_("line too long");
+            }
+            if (window < maxWindow) {
+                // 后面的数据在下一个块中：合并的长度成倍增加，已解析的偏移不变
+                size_t grown = std::max(window * 2, static_cast<size_t>(Buffer::CHUNK_SIZE));
+                window = std::min(grown, maxWindow);
+                base_ = buff.Linearize(window);
+                continue;
             }
-            ParsePath_();
-            break;
-        case HEADERS:
-            ParseHeader_(line);
-            if (buff.ReadableBytes() <= 2) {
-                state_ = FINISH;
+            if (maxWindow != readable) {
+                return Fail_("header too large");
             }
-            break;
-        case BODY: state_ = FINISH; break;
-        default: break;
+            return false;
+        }
+        size_t lineEnd = p - base_;
+        size_t next;
+        if (*p == '\n') {
+            next = lineEnd + 1;
+        } else if (*p == '\r' && p[1] == '\n') {
+            next = lineEnd + 2;
+        } else {
+            return Fail_("invalid character");
+        }
+        if (lineEnd - lineStart_ > MAX_LINE) {
+            return Fail_("line too long");
         }
-        if (lineEnd == buff.BeginWrite()) {
-            break;
+        if (lineEnd == lineStart_) {
+            if (state_ == HEADERS) {
+                // 请求头结束
+                headerLen_ = next;
+                state_ = contentLength_ > 0 ? BODY : FINISH;
+            }
+            // 请求行之前的空行忽略
+        } else if (state_ == REQUEST_LINE ? !ParseRequestLine_(lineStart_, lineEnd)
+                                          : !ParseHeader_(lineStart_, lineEnd)) {
+            return false;
         }
-        buff.RetrieveUntil(lineEnd + 2);
+        lineStart_ = scanned_ = next;
     }
-    LOG_DEBUG("[%s], [%s], [%s]", method_.c_str(), path_.c_str(), version_.c_str());
+    if (readable < headerLen_ + contentLength_) {
+        return false;
+    }
+    state_ = FINISH;
+    length_ = headerLen_ + contentLength_;
+    httpCode = GET_REQUEST;
+    LOG_DEBUG("[%.*s], [%.*s], [%.*s]", (int)method_.len, View_(method_).data, (int)target_.len,
+              View_(target_).data, (int)version_.len, View_(version_).data);
     return true;
 }
 
-void HttpRequest::ParsePath_() {
-    if (path_ == "/") {
-        path_ = "/index.html";
-    } else {
-        for (auto &item : DEFAULT_HTML) {
-            if (item == path_) {
-                path_ += ".html";
-                break;
-            }
-        }
+bool HttpRequest::ParseRequestLine_(size_t begin, size_t end) {
+    // 方法 SP 路径 SP HTTP/版本
+    const char *line = base_ + begin;
+    auto sp1 = static_cast<const char *>(memchr(line, ' ', end - begin));
+    if (!sp1 || sp1 == line) {
+        return Fail_("malformed request line");
     }
+    auto targetBegin = sp1 + 1;
+    auto sp2 = static_cast<const char *>(memchr(targetBegin, ' ', base_ + end - targetBegin));
+    if (!sp2 || sp2 == targetBegin) {
+        return Fail_("malformed request line");
+    }
+    auto versionBegin = sp2 + 1;
+    size_t versionLen = base_ + end - versionBegin;
+    if (versionLen <= 5 || memcmp(versionBegin, "HTTP/", 5) != 0
+        || memchr(versionBegin, ' ', versionLen)) {
+        return Fail_("malformed request line");
+    }
+    method_ = Field_(begin, sp1 - base_);
+    target_ = Field_(targetBegin - base_, sp2 - base_);
+    version_ = Field_(versionBegin + 5 - base_, end);
+    http11_ = View_(version_) == "1.1";
+    ParsePath_();
+    state_ = HEADERS;
+    return true;
 }
 
-bool HttpRequest::ParseRequestLine_(const string &line) {
-    std::regex patten("^([^ ]*) ([^ ]*) HTTP/([^ ]*)$");
-    std::smatch subMatch;
-    if (regex_match(line, subMatch, patten)) {
-        method_ = subMatch[1];
-        path_ = subMatch[2];
-        version_ = subMatch[3];
-        state_ = HEADERS;
-        return true;
+bool HttpRequest::ParseHeader_(size_t begin, size_t end) {
+    if (base_[begin] == ' ' || base_[begin] == '\t') {
+        return Fail_("obsolete line folding");
     }
-    LOG_ERROR("RequestLine Error");
-    return false;
-}
+    auto colon = static_cast<const char *>(memchr(base_ + begin, ':', end - begin));
+    if (!colon || colon == base_ + begin) {
+        return Fail_("malformed header");
+    }
+    size_t nameEnd = colon - base_;
+    if (base_[nameEnd - 1] == ' ' || base_[nameEnd - 1] == '\t') {
+        return Fail_("whitespace before colon");
+    }
+    if (headerCount_ == MAX_HEADERS) {
+        return Fail_("too many headers");
+    }
+    size_t valueBegin = nameEnd + 1, valueEnd = end;
+    trim(base_, &valueBegin, &valueEnd);
+    auto &header = headers_[headerCount_++];
+    header.name = Field_(begin, nameEnd);
+    header.value = Field_(valueBegin, valueEnd);
 
-void HttpRequest::ParseHeader_(const string &line) {
-    std::regex patten("^([^:]*): ?(.*)$");
-    std::smatch subMatch;
-    if (regex_match(line, subMatch, patten)) {
-        header_[subMatch[1]] = subMatch[2];
-    } else {
-        state_ = BODY;
+    auto name = View_(header.name);
+    auto value = View_(header.value);
+    if (name.equalsIgnoreCase("Content-Length")) {
+        size_t length = 0;
+        if (value.empty() || value.len > 12) {
+            return Fail_("invalid content-length");
+        }
+        for (size_t i = 0; i < value.len; i++) {
+            if (value.data[i] < '0' || value.data[i] > '9') {
+                return Fail_("invalid content-length");
+            }
+            length = length * 10 + (value.data[i] - '0');
+        }
+        if (hasContentLength_ && length != contentLength_) {
+            return Fail_("conflicting content-length");
+        }
+        hasContentLength_ = true;
+        contentLength_ = length;
+    } else if (name.equalsIgnoreCase("Transfer-Encoding")) {
+        // 不支持分块传输的请求体，无法确定请求的边界
+        return Fail_("transfer-encoding not supported");
+    } else if (name.equalsIgnoreCase("Connection")) {
+        keepAlive_ = value.equalsIgnoreCase("keep-alive");
     }
+    return true;
 }
 
-int HttpRequest::ConverHex(char ch) {
-    if (ch >= 'A' && ch <= 'F')
-        return ch - 'A' + 10;
-    if (ch >= 'a' && ch <= 'f')
-        return ch - 'a' + 10;
-    return ch;
+void HttpRequest::ParsePath_() {
+    auto target = View_(target_);
+    for (auto &item : DEFAULT_HTML) {
+        if (item.path == target) {
+            mappedPath_ = item.file;
+            return;
+        }
+    }
+    mappedPath_ = nullptr;
 }
 
-std::string HttpRequest::path() const {
-    return path_;
+StrView HttpRequest::path() const {
+    return mappedPath_ ? StrView(mappedPath_) : View_(target_);
 }
 
-std::string &HttpRequest::path() {
-    return path_;
+StrView HttpRequest::method() const {
+    return View_(method_);
 }
-std::string HttpRequest::method() const {
-    return method_;
+
+StrView HttpRequest::version() const {
+    return View_(version_);
 }
 
-std::string HttpRequest::version() const {
-    return version_;
-}
\ No newline at end of file
+StrView HttpRequest::header(StrView name) const {
+    for (int i = 0; i < headerCount_; i++) {
+        if (View_(headers_[i].name).equalsIgnoreCase(name)) {
+            return View_(headers_[i].value);
+        }
+    }
+    return {};
+}
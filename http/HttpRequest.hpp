@@ -1,14 +1,14 @@
 #pragma once
 
-#include <unordered_map>
-#include <unordered_set>
+#include <cstdint>
 
 #include "../base/Buffer.hpp"
+#include "../base/StrView.hpp"
 
-using std::string;
-using std::unordered_map;
-using std::unordered_set;
-
+// HTTP/1.1请求的增量解析器：请求不完整时记住已扫描到的位置，下次从该处继续，不重复扫描；
+// 行尾与非法字符的查找按CPU在运行时选用AVX2、SSE4.2或逐字节实现；
+// 直接扫描读缓冲区第一个块中的数据，只有请求头跨越块的边界时才将其合并为连续数据
+// 方法、路径、版本与请求头均以视图的形式指向读缓冲区，不复制到字符串中
 class HttpRequest {
 public:
     enum PARSE_STATE {
@@ -29,33 +29,88 @@ public:
         CLOSED_CONNECTION,
     };
 
+    // 请求行或单个请求头行的长度上限
+    static const size_t MAX_LINE = 8192;
+    // 请求行与全部请求头的总长度上限，偏移以16位存放，不能超过65535
+    static const size_t MAX_HEADER_SIZE = 32768;
+    static const int MAX_HEADERS = 32;
+
     HTTP_CODE httpCode;
 
     HttpRequest() { Init(); }
     ~HttpRequest() = default;
 
     void Init();
+    // 连接空闲时重置解析状态
+    void Release();
+
+    // 从buff开头解析一个请求，请求完整时返回true；请求的数据仍留在buff中，
+    // 处理完后由调用者取走Length()字节，下次调用时从新请求开始
+    // 请求不完整时返回false且httpCode为NO_REQUEST，请求有误时返回false且httpCode为BAD_REQUEST
     bool parse(Buffer &buff);
 
-    std::string path() const;
-    std::string &path();
-    std::string method() const;
-    std::string version() const;
+    // 以下视图指向parse时的读缓冲区，在请求的数据被取走或缓冲区被写入之前有效
+    // 默认页面的路径（如"/"与"/login"）指向静态的".html"路径
+    StrView path() const;
+    StrView method() const;
+    StrView version() const;
+    // 按名称查找请求头（忽略大小写），不存在时返回空视图
+    StrView header(StrView name) const;
+
+    // 已完成的请求在缓冲区中占用的字节数（包括请求之前的空行与请求体）
+    size_t Length() const { return length_; }
 
     bool IsKeepAlive() const;
 
+    PARSE_STATE state() const { return state_; }
+
+    // 运行时选用的扫描实现："avx2"、"sse4.2"或"scalar"
+    static const char *Scanner();
+
+    // 返回[p, end)中第一个控制字符（除HT）的位置，没有时返回end
+    typedef const char *(*ScanFunc)(const char *p, const char *end);
+    // 按名称取得扫描实现，供测试比较各实现的结果；CPU不支持或名称未知时返回nullptr
+    static ScanFunc ScannerImpl(const char *name);
+
 private:
-    bool ParseRequestLine_(const std::string &line);
-    void ParseHeader_(const std::string &line);
-    void ParseBody_(const std::string &line);
+    // 相对读缓冲区开头的偏移与长度
+    struct Field {
+        uint16_t off;
+        uint16_t len;
+    };
+    struct Header {
+        Field name;
+        Field value;
+    };
 
+    // 处理[begin, end)之间的一行（不含行尾），失败时已设置httpCode
+    bool ParseRequestLine_(size_t begin, size_t end);
+    bool ParseHeader_(size_t begin, size_t end);
     void ParsePath_();
+    bool Fail_(const char *reason);
+
+    StrView View_(Field field) const { return {base_ + field.off, field.len}; }
+    static Field Field_(size_t begin, size_t end) {
+        return {static_cast<uint16_t>(begin), static_cast<uint16_t>(end - begin)};
+    }
 
     PARSE_STATE state_;
-    std::string method_, path_, version_, body_;
-    std::unordered_map<std::string, std::string> header_;
+    // 上一次parse时读缓冲区的开头
+    const char *base_;
+    // 当前行的开头与下一次扫描的起点
+    size_t lineStart_;
+    size_t scanned_;
+    // 请求头（包括结尾的空行）与请求体的长度
+    size_t headerLen_;
+    size_t contentLength_;
+    size_t length_;
 
-    static const std::unordered_set<std::string> DEFAULT_HTML;
-    static const std::unordered_map<std::string, int> DEFAULT_HTML_TAG;
-    static int ConverHex(char ch);
-};
\ No newline at end of file
+    Field method_, target_, version_;
+    // 默认页面对应的静态路径，为空时使用请求中的路径
+    const char *mappedPath_;
+    bool http11_;
+    bool keepAlive_;
+    bool hasContentLength_;
+    int headerCount_;
+    Header headers_[MAX_HEADERS];
+};
@@ -2,25 +2,32 @@
 #include <fcntl.h>    // open
 #include <unistd.h>   // close
 #include <sys/mman.h> // mmap, munmap
-
-const unordered_map<string, string> HttpResponse::SUFFIX_TYPE = {
+#include <algorithm>
+#include <cstdio>     // snprintf
+#include <cstring>
+#include "../base/AllocStats.hpp"
+#include "../base/Clock.hpp"
+#include "FileCache.hpp"
+
+// 后缀不多，顺序查找即可，不必为查找构造字符串
+const HttpResponse::SuffixType HttpResponse::SUFFIX_TYPE[] = {
     {".html", "text/html"},          {".xml", "text/xml"},          {".xhtml", "application/xhtml+xml"},
     {".txt", "text/plain"},          {".rtf", "application/rtf"},   {".pdf", "application/pdf"},
     {".word", "application/nsword"}, {".png", "image/png"},         {".gif", "image/gif"},
     {".jpg", "image/jpeg"},          {".jpeg", "image/jpeg"},       {".au", "audio/basic"},
     {".mpeg", "video/mpeg"},         {".mpg", "video/mpeg"},        {".avi", "video/x-msvideo"},
     {".gz", "application/x-gzip"},   {".tar", "application/x-tar"}, {".css", "text/css "},
-    {".js", "text/javascript "},
+    {".js", "text/javascript "},     {nullptr, nullptr},
 };
 
-const unordered_map<int, string> HttpResponse::CODE_STATUS = {
+const unordered_map<int, const char *> HttpResponse::CODE_STATUS = {
     {200, "OK"},
     {400, "Bad Request"},
     {403, "Forbidden"},
     {404, "Not Found"},
 };
 
-const unordered_map<int, string> HttpResponse::CODE_PATH = {
+const unordered_map<int, const char *> HttpResponse::CODE_PATH = {
     {400, "/400.html"},
     {403, "/403.html"},
     {404, "/404.html"},
@@ -28,9 +35,11 @@ const unordered_map<int, string> HttpResponse::CODE_PATH = {
 
 HttpResponse::HttpResponse() {
     code_ = -1;
-    path_ = srcDir_ = "";
+    file_[0] = '\0';
+    dirLen_ = 0;
     isKeepAlive_ = false;
     mmFile_ = nullptr;
+    mapped_ = false;
     mmFileStat_ = {0};
 };
 
@@ -38,22 +47,32 @@ HttpResponse::~HttpResponse() {
     UnmapFile();
 }
 
-void HttpResponse::Init(const string &srcDir, string &path, bool isKeepAlive, int code) {
-    assert(!srcDir.empty());
+void HttpResponse::Init(const char *srcDir, StrView path, bool isKeepAlive, int code) {
+    ALLOC_SCOPE(RESPONSE);
+    assert(srcDir && *srcDir);
     if (mmFile_) {
         UnmapFile();
     }
     code_ = code;
     isKeepAlive_ = isKeepAlive;
-    path_ = path;
-    srcDir_ = srcDir;
+    dirLen_ = std::min(strlen(srcDir), sizeof(file_) - 1);
+    memcpy(file_, srcDir, dirLen_);
+    if (dirLen_ + path.len < sizeof(file_)) {
+        memcpy(file_ + dirLen_, path.data, path.len);
+        file_[dirLen_ + path.len] = '\0';
+    } else {
+        file_[dirLen_] = '\0';
+    }
     mmFile_ = nullptr;
     mmFileStat_ = {0};
 }
 
 void HttpResponse::MakeResponse(Buffer &buff) {
+    ALLOC_SCOPE(RESPONSE);
     /* 判断请求的资源文件 */
-    if (stat((srcDir_ + path_).data(), &mmFileStat_) < 0 || S_ISDIR(mmFileStat_.st_mode)) {
+    if (code_ == 400) {
+        // 解析出错的请求保持400
+    } else if (stat(file_, &mmFileStat_) < 0 || S_ISDIR(mmFileStat_.st_mode)) {
         code_ = 404;
     } else if (!(mmFileStat_.st_mode & S_IROTH)) {
         code_ = 403;
@@ -75,88 +94,112 @@ size_t HttpResponse::FileLen() const {
 }
 
 void HttpResponse::ErrorHtml_() {
-    if (CODE_PATH.count(code_) == 1) {
-        path_ = CODE_PATH.find(code_)->second;
-        stat((srcDir_ + path_).data(), &mmFileStat_);
+    auto it = CODE_PATH.find(code_);
+    if (it != CODE_PATH.end()) {
+        // 错误页面的路径都很短，srcDir之后总能放下
+        snprintf(file_ + dirLen_, sizeof(file_) - dirLen_, "%s", it->second);
+        stat(file_, &mmFileStat_);
     }
 }
 
 void HttpResponse::AddStateLine_(Buffer &buff) {
-    string status;
-    if (CODE_STATUS.count(code_) == 1) {
-        status = CODE_STATUS.find(code_)->second;
-    } else {
+    auto it = CODE_STATUS.find(code_);
+    if (it == CODE_STATUS.end()) {
         code_ = 400;
-        status = CODE_STATUS.find(400)->second;
+        it = CODE_STATUS.find(400);
     }
-    buff.Append("HTTP/1.1 " + std::to_string(code_) + " " + status + "\r\n");
+    char line[64];
+    int len = snprintf(line, sizeof(line), "HTTP/1.1 %d %s\r\n", code_, it->second);
+    buff.Append(line, len);
 }
 
 void HttpResponse::AddHeader_(Buffer &buff) {
-    buff.Append("Connection: ");
+    // Date取自每秒格式化一次的缓存
+    char date[CoarseClock::HTTP_DATE_LEN];
+    CoarseClock::httpDate(date);
+    buff.Append("Date: ", 6);
+    buff.Append(date, sizeof(date));
+    buff.Append("\r\n", 2);
+    // 字符串字面量直接按长度追加，不经过std::string
+    static const char keepAliveHeader[] = "Connection: keep-alive\r\nkeep-alive: max=6, timeout=120\r\n";
+    static const char closeHeader[] = "Connection: close\r\n";
     if (isKeepAlive_) {
-        buff.Append("keep-alive\r\n");
-        buff.Append("keep-alive: max=6, timeout=120\r\n");
+        buff.Append(keepAliveHeader, sizeof(keepAliveHeader) - 1);
     } else {
-        buff.Append("close\r\n");
+        buff.Append(closeHeader, sizeof(closeHeader) - 1);
     }
-    buff.Append("Content-type: " + GetFileType_() + "\r\n");
+    char line[64];
+    int len = snprintf(line, sizeof(line), "Content-type: %s\r\n", GetFileType_());
+    buff.Append(line, len);
 }
 
 void HttpResponse::AddContent_(Buffer &buff) {
-    int srcFd = open((srcDir_ + path_).data(), O_RDONLY);
-    if (srcFd < 0) {
-        ErrorContent(buff, "File NotFound!");
-        return;
+    /* 较小的文件直接从共享缓存中发送，不再每次打开并映射 */
+    mmFile_ = const_cast<char *>(FileCache::get().lookup(file_, mmFileStat_));
+    if (!mmFile_ && mmFileStat_.st_size > 0) {
+        int srcFd = open(file_, O_RDONLY);
+        if (srcFd < 0) {
+            ErrorContent(buff, "File NotFound!");
+            return;
+        }
+
+        /* 将文件映射到内存提高文件的访问速度
+            MAP_PRIVATE 建立一个写入时拷贝的私有映射*/
+        // LOG_DEBUG("file path %s", file_);
+        void *mmRet = mmap(nullptr, mmFileStat_.st_size, PROT_READ, MAP_PRIVATE, srcFd, 0);
+        close(srcFd);
+        if (mmRet == MAP_FAILED) {
+            ErrorContent(buff, "File NotFound!");
+            return;
+        }
+        mmFile_ = static_cast<char *>(mmRet);
+        mapped_ = true;
     }
+    char line[64];
+    int len = snprintf(line, sizeof(line), "Content-length: %lld\r\n\r\n",
+                       static_cast<long long>(mmFileStat_.st_size));
+    buff.Append(line, len);
+}
 
-    /* 将文件映射到内存提高文件的访问速度
-        MAP_PRIVATE 建立一个写入时拷贝的私有映射*/
-    // LOG_DEBUG("file path %s", (srcDir_ + path_).data());
-    int *mmRet = (int *)mmap(nullptr, mmFileStat_.st_size, PROT_READ, MAP_PRIVATE, srcFd, 0);
-    if (*mmRet == -1) {
-        ErrorContent(buff, "File NotFound!");
-        return;
-    }
-    mmFile_ = (char *)mmRet;
-    close(srcFd);
-    buff.Append("Content-length: " + std::to_string(mmFileStat_.st_size) + "\r\n\r\n");
+void HttpResponse::Release() {
+    UnmapFile();
+    file_[dirLen_] = '\0';
 }
 
 void HttpResponse::UnmapFile() {
-    if (mmFile_) {
+    // 缓存中的内容不属于响应，只解除自己建立的映射
+    if (mmFile_ && mapped_) {
         munmap(mmFile_, mmFileStat_.st_size);
-        mmFile_ = nullptr;
     }
+    mmFile_ = nullptr;
+    mapped_ = false;
 }
 
-string HttpResponse::GetFileType_() {
+const char *HttpResponse::GetFileType_() const {
     /* 判断文件类型 */
-    string::size_type idx = path_.find_last_of('.');
-    if (idx == string::npos) {
+    const char *suffix = strrchr(Path_(), '.');
+    if (!suffix) {
         return "text/plain";
     }
-    string suffix = path_.substr(idx);
-    if (SUFFIX_TYPE.count(suffix) == 1) {
-        return SUFFIX_TYPE.find(suffix)->second;
+    for (auto entry = SUFFIX_TYPE; entry->suffix; entry++) {
+        if (strcmp(suffix, entry->suffix) == 0) {
+            return entry->type;
+        }
     }
     return "text/plain";
 }
 
-void HttpResponse::ErrorContent(Buffer &buff, const string &message) {
-    string body;
-    string status;
-    body += "<html><title>Error</title>";
-    body += "<body bgcolor=\"ffffff\">";
-    if (CODE_STATUS.count(code_) == 1) {
-        status = CODE_STATUS.find(code_)->second;
-    } else {
-        status = "Bad Request";
-    }
-    body += std::to_string(code_) + " : " + status + "\n";
-    body += "<p>" + message + "</p>";
-    body += "<hr><em>TinyWebServer</em></body></html>";
-
-    buff.Append("Content-length: " + std::to_string(body.size()) + "\r\n\r\n");
-    buff.Append(body);
+void HttpResponse::ErrorContent(Buffer &buff, const char *message) {
+    auto it = CODE_STATUS.find(code_);
+    const char *status = it != CODE_STATUS.end() ? it->second : "Bad Request";
+    char body[512];
+    int len = snprintf(body, sizeof(body),
+                       "<html><title>Error</title><body bgcolor=\"ffffff\">%d : %s\n<p>%s</p>"
+                       "<hr><em>TinyWebServer</em></body></html>",
+                       code_, status, message);
+    len = std::min(len, static_cast<int>(sizeof(body)) - 1);
+    char line[64];
+    int lineLen = snprintf(line, sizeof(line), "Content-length: %d\r\n\r\n", len);
+    buff.Append(line, lineLen);
+    buff.Append(body, len);
 }
\ No newline at end of file
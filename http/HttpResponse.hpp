@@ -2,9 +2,11 @@
 
 #include <unordered_map>
 #include <sys/stat.h> // stat
+#include <climits>    // PATH_MAX
 #include <cassert>
 
 #include "../base/Buffer.hpp"
+#include "../base/StrView.hpp"
 
 using std::string;
 using std::unordered_map;
@@ -14,12 +16,16 @@ public:
     HttpResponse();
     ~HttpResponse();
 
-    void Init(const std::string &srcDir, std::string &path, bool isKeepAlive = false, int code = -1);
+    // srcDir须在响应的生命周期内有效（如HttpConn::srcDir），path在调用后即可失效
+    // 完整路径复制到响应内的定长数组中，生成响应的过程不分配内存
+    void Init(const char *srcDir, StrView path, bool isKeepAlive = false, int code = -1);
     void MakeResponse(Buffer &buff);
     void UnmapFile();
+    // 连接空闲时解除文件映射
+    void Release();
     char *File();
     size_t FileLen() const;
-    void ErrorContent(Buffer &buff, const std::string &message);
+    void ErrorContent(Buffer &buff, const char *message);
     int Code() const { return code_; }
 
 private:
@@ -28,18 +34,28 @@ private:
     void AddContent_(Buffer &buff);
 
     void ErrorHtml_();
-    std::string GetFileType_();
+    // 按后缀返回Content-type，未知的后缀返回text/plain
+    const char *GetFileType_() const;
+    // 请求路径（完整路径中srcDir之后的部分）
+    const char *Path_() const { return file_ + dirLen_; }
 
     int code_;
     bool isKeepAlive_;
 
-    std::string path_;
-    std::string srcDir_;
+    // srcDir与请求路径拼接成的完整路径，超出PATH_MAX时只保留srcDir（目录，按404处理）
+    char file_[PATH_MAX];
+    size_t dirLen_;
 
+    // 文件内容，来自FileCache或本响应建立的映射（mapped_为true）
     char *mmFile_;
+    bool mapped_;
     struct stat mmFileStat_;
 
-    static const std::unordered_map<std::string, std::string> SUFFIX_TYPE;
-    static const std::unordered_map<int, std::string> CODE_STATUS;
-    static const std::unordered_map<int, std::string> CODE_PATH;
+    struct SuffixType {
+        const char *suffix;
+        const char *type;
+    };
+    static const SuffixType SUFFIX_TYPE[];
+    static const std::unordered_map<int, const char *> CODE_STATUS;
+    static const std::unordered_map<int, const char *> CODE_PATH;
 };
\ No newline at end of file
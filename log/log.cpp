@@ -5,6 +5,8 @@
  */
 #include <sys/time.h>
 #include "log.h"
+#include "../base/AllocStats.hpp"
+#include "../base/Clock.hpp"
 
 using namespace std;
 
@@ -89,27 +91,29 @@ void Log::init(int level = 1, const char* path, const char* suffix,
 }
 
 void Log::write(int level, const char *format, ...) {
-    struct timeval now = {0, 0};
-    gettimeofday(&now, nullptr);
-    time_t tSec = now.tv_sec;
-    struct tm *sysTime = localtime(&tSec);
-    struct tm t = *sysTime;
+    ALLOC_SCOPE(LOG);
+    /* 使用IO线程缓存的时间与预先格式化的前缀，不再每行调用gettimeofday与localtime */
+    char prefix[CoarseClock::LOG_PREFIX_LEN];
+    int mday = CoarseClock::logPrefix(prefix);
+    long usec = static_cast<long>(CoarseClock::wallUs() % 1000000);
     va_list vaList;
 
     /* 日志日期 日志行数 */
-    if (toDay_ != t.tm_mday || (lineCount_ && (lineCount_  %  MAX_LINES == 0)))
+    if (toDay_ != mday || (lineCount_ && (lineCount_  %  MAX_LINES == 0)))
     {
         unique_lock<mutex> locker(mtx_);
         locker.unlock();
         
         char newFile[LOG_NAME_LEN];
+        /* 前缀的前10个字符为"YYYY-MM-DD" */
         char tail[36] = {0};
-        snprintf(tail, 36, "%04d_%02d_%02d", t.tm_year + 1900, t.tm_mon + 1, t.tm_mday);
+        memcpy(tail, prefix, 10);
+        tail[4] = tail[7] = '_';
 
-        if (toDay_ != t.tm_mday)
+        if (toDay_ != mday)
         {
             snprintf(newFile, LOG_NAME_LEN - 72, "%s/%s%s", path_, tail, suffix_);
-            toDay_ = t.tm_mday;
+            toDay_ = mday;
             lineCount_ = 0;
         }
         else {
@@ -126,24 +130,35 @@ void Log::write(int level, const char *format, ...) {
     {
         unique_lock<mutex> locker(mtx_);
         lineCount_++;
-        int n = snprintf(buff_.BeginWrite(), 128, "%d-%02d-%02d %02d:%02d:%02d.%06ld ",
-                    t.tm_year + 1900, t.tm_mon + 1, t.tm_mday,
-                    t.tm_hour, t.tm_min, t.tm_sec, now.tv_usec);
-                    
-        buff_.HasWritten(n);
+        char stamp[CoarseClock::LOG_PREFIX_LEN + 8];
+        memcpy(stamp, prefix, CoarseClock::LOG_PREFIX_LEN);
+        char *p = stamp + CoarseClock::LOG_PREFIX_LEN;
+        *p++ = '.';
+        for (int i = 5; i >= 0; i--, usec /= 10) {
+            p[i] = static_cast<char>('0' + usec % 10);
+        }
+        p[6] = ' ';
+        buff_.Append(stamp, sizeof(stamp));
         AppendLogLevelTitle_(level);
 
+        buff_.EnsureWriteable(256);
         va_start(vaList, format);
         int m = vsnprintf(buff_.BeginWrite(), buff_.WritableBytes(), format, vaList);
         va_end(vaList);
 
+        /* 超出可写空间的部分已被截断 */
+        if (m < 0) {
+            m = 0;
+        } else if (static_cast<size_t>(m) >= buff_.WritableBytes()) {
+            m = static_cast<int>(buff_.WritableBytes()) - 1;
+        }
         buff_.HasWritten(m);
         buff_.Append("\n\0", 2);
 
         if(isAsync_ && deque_ && !deque_->full()) {
             deque_->push_back(buff_.RetrieveAllToStr());
         } else {
-            fputs(buff_.Peek(), fp_);
+            fputs(buff_.Linearize(buff_.ReadableBytes()), fp_);
         }
         buff_.RetrieveAll();
     }
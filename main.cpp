@@ -1,8 +1,59 @@
+#include <algorithm>
 #include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h> // getopt()
 #include "server/Server.hpp"
 
-int main() {
+// 用法: WebServer [-p 端口] [-l 监听地址]... [-t 最大工作线程数] [-T 最小工作线程数]
+//                  [-r 子Reactor数] [-L] [-w worker进程数] [-A] [-N] [-u] [-c] [-b 微秒] [-B 微秒]
+//                  [-q 监听队列长度] [-D 秒] [-F 队列长度] [-m 请求数] [-d 毫秒,...]
+//                  [-M 最大连接数] [-K 缓冲区内存上限MB]
+// -l 可重复指定，如 -l 8080 -l [::]:8443 -l unix:/run/ws.sock -l unix:@ws，指定后不再使用-p
+// -t/-T 默认按CPU数确定，线程池在两者之间按任务排队时间伸缩；-t 0 表示不使用线程池
+// -L 表示按最小负载而非轮询将新连接分发给子Reactor
+// -w 开启多进程模式，-w -1 表示每个CPU一个worker；-A 表示不绑定CPU
+// -N 按NUMA节点放置子Reactor、线程池与连接槽，子Reactor数至少为节点数
+// -u 使用io_uring后端代替epoll
+// -c 开启run-to-completion模式，小请求直接在IO线程中处理
+// -q 设置listen的backlog；-D 开启TCP_DEFER_ACCEPT；-F 开启TCP_FASTOPEN
+// -m 设置同一连接一次连续处理的请求数上限
+// -M 设置最大连接数，按需提高打开文件数限制；-K 设置所有缓冲区的内存上限，超出时拒绝新连接
+// -d 依次设置请求头、请求体、keep-alive空闲与发送停滞的超时，如 -d 10000,30000,60000,30000，可只给出前几项
+// -b 开启忙轮询，参数为IO线程阻塞前自旋时间的上限；-B 为已接受的连接设置SO_BUSY_POLL
+int main(int argc, char *argv[]) {
     signal(SIGPIPE, SIG_IGN); // 忽略SIGPIPE信号
-    Server server{1316, 20, 60000, false, 0};
+    ServerOptions options;
+    options.logLevel = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "p:l:t:T:r:Lw:ANucb:B:q:D:F:m:d:M:K:")) != -1) {
+        switch (opt) {
+        case 'p': options.port = atoi(optarg); break;
+        case 'l': options.listeners.push_back(optarg); break;
+        case 't': options.threadNum = atoi(optarg); break;
+        case 'T': options.minThreads = atoi(optarg); break;
+        case 'r': options.subReactorNum = atoi(optarg); break;
+        case 'L': options.dispatchPolicy = ReactorPool::LEAST_LOADED; break;
+        case 'w': options.workerProcesses = atoi(optarg); break;
+        case 'A': options.cpuAffinity = false; break;
+        case 'N': options.numa = true; break;
+        case 'u': options.ioBackend = Poller::IO_URING; break;
+        case 'c': options.runToCompletion = true; break;
+        case 'b': options.busyPollUs = atoi(optarg); break;
+        case 'B': options.socketBusyPollUs = atoi(optarg); break;
+        case 'q': options.listenBacklog = atoi(optarg); break;
+        case 'D': options.deferAcceptSec = atoi(optarg); break;
+        case 'F': options.fastOpenQueue = atoi(optarg); break;
+        case 'm': options.maxRequestsPerTurn = std::max(atoi(optarg), 1); break;
+        case 'M': options.maxConnections = atoi(optarg); break;
+        case 'K': options.memoryBudget = static_cast<size_t>(atol(optarg)) << 20; break;
+        case 'd':
+            sscanf(optarg, "%d,%d,%d,%d", &options.headerTimeoutMs, &options.bodyTimeoutMs,
+                   &options.timeoutMS, &options.writeTimeoutMs);
+            break;
+        default: return 1;
+        }
+    }
+    Server server{options};
     server.start();
 }
@@ -1,19 +1,26 @@
 #pragma once
 
 #include <sys/epoll.h>
-#include <sys/epoll.h>
-#include <functional>
+#include <atomic>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <unordered_map>
 
+#include "../base/InlineCallback.hpp"
+
 class Channel {
 private:
-    typedef std::function<void()> CallBack;
+    // 处理器在连接建立时设置一次，以固定大小的内联缓冲区存储，调用与设置均不分配内存
+    typedef InlineCallback<32> CallBack;
     int fd_;
-    __uint32_t events_;
-    __uint32_t revents_{};
+    // fd关闭并被复用后，原Reactor的线程仍可能读取代数并写入事件，与新所有者的线程并发，
+    // 因此以下三个字段为原子变量，均使用relaxed顺序，事件的处理由连接的所有权标记同步
+    std::atomic<__uint32_t> events_;
+    std::atomic<__uint32_t> revents_{0};
     __uint32_t lastEvents_;
+    // 注册代数，每次注册与注销时递增，用于识别fd复用后残留的就绪事件
+    std::atomic<uint16_t> tag_{0};
 
 private:
     CallBack readHandler_;
@@ -23,32 +30,33 @@ private:
     CallBack closeHandler_;
 
 public:
-    Channel() : events_(0), lastEvents_(0), fd_(0) {}
-    explicit Channel(int fd) : events_(0), lastEvents_(0), fd_(fd) {}
+    Channel() : fd_(0), events_(0), lastEvents_(0) {}
+    explicit Channel(int fd) : fd_(fd), events_(0), lastEvents_(0) {}
     int getFd() const { return fd_; }
     void setFd(int fd) { fd_ = fd; }
 
-    void setConnHandler(CallBack &&connHandler) { connHandler_ = connHandler; }
-    void setReadHandler(CallBack &&readHandler) { readHandler_ = readHandler; }
-    void setWriteHandler(CallBack &&writeHandler) { writeHandler_ = writeHandler; }
-    void setCloseHandler(CallBack &&closeHandler) { closeHandler_ = closeHandler; }
-    void setErrorHandler(CallBack &&errorHandler) { errorHandler_ = errorHandler; }
+    void setConnHandler(CallBack &&connHandler) { connHandler_ = std::move(connHandler); }
+    void setReadHandler(CallBack &&readHandler) { readHandler_ = std::move(readHandler); }
+    void setWriteHandler(CallBack &&writeHandler) { writeHandler_ = std::move(writeHandler); }
+    void setCloseHandler(CallBack &&closeHandler) { closeHandler_ = std::move(closeHandler); }
+    void setErrorHandler(CallBack &&errorHandler) { errorHandler_ = std::move(errorHandler); }
 
     void handleEvents() {
-        events_ = 0;
-        if (revents_ & (EPOLLHUP | EPOLLRDHUP)) {
+        setEvents(0);
+        auto revents = getRevents();
+        if (revents & (EPOLLHUP | EPOLLRDHUP)) {
             if (closeHandler_)
                 closeHandler_();
-            events_ = 0;
+            setEvents(0);
             return;
         }
-        if (revents_ & EPOLLERR) {
+        if (revents & EPOLLERR) {
             if (errorHandler_)
                 errorHandler_();
-            events_ = 0;
+            setEvents(0);
             return;
         }
-        if (revents_ & (EPOLLIN | EPOLLPRI)) {
+        if (revents & (EPOLLIN | EPOLLPRI)) {
             if (readHandler_) {
                 readHandler_();
             } else {
@@ -57,26 +65,31 @@ public:
                 }
             }
         }
-        if (revents_ & EPOLLOUT) {
+        if (revents & EPOLLOUT) {
             if (writeHandler_) {
                 writeHandler_();
             }
         }
     }
 
-    void setRevents(__uint32_t ev) { revents_ = ev; }
+    void setRevents(__uint32_t ev) { revents_.store(ev, std::memory_order_relaxed); }
+    __uint32_t getRevents() const { return revents_.load(std::memory_order_relaxed); }
 
-    void setEvents(__uint32_t ev) { events_ = ev; }
-    __uint32_t &getEvents() { return events_; }
+    void setEvents(__uint32_t ev) { events_.store(ev, std::memory_order_relaxed); }
+    __uint32_t getEvents() const { return events_.load(std::memory_order_relaxed); }
 
     bool EqualAndUpdateLastEvents() {
-        bool ret = (lastEvents_ == events_ && !(lastEvents_ & EPOLLONESHOT));
+        auto events = getEvents();
+        bool ret = (lastEvents_ == events && !(lastEvents_ & EPOLLONESHOT));
         // 如果设置了EPOLLONESHOT,则每次事件触发后都必须重新添加关注事件，否则将不再触发
-        lastEvents_ = events_;
+        lastEvents_ = events;
         return ret;
     }
 
     __uint32_t getLastEvents() const { return lastEvents_; }
+
+    uint16_t getTag() const { return tag_.load(std::memory_order_relaxed); }
+    uint16_t nextTag() { return tag_.fetch_add(1, std::memory_order_relaxed) + 1; }
 };
 
 typedef std::shared_ptr<Channel> SP_Channel;
\ No newline at end of file
@@ -7,9 +7,10 @@
 const int EVENTSNUM = 4096;
 const int EPOLLWAIT_TIME = 10000;
 
-Epoll::Epoll() : epollFd(epoll_create1(EPOLL_CLOEXEC)), events_(EVENTSNUM) {
-    assert(epollFd > 0);
-    fd2chan_ = std::vector<SP_Channel>(MAXFDS);
+Epoll::Epoll(int maxFds) : epollFd(epoll_create1(EPOLL_CLOEXEC)), events_(EVENTSNUM) {
+    assert(epollFd > 0 && maxFds > 0);
+    fd2chan_ = std::vector<SP_Channel>(maxFds);
+    ready_.reserve(EVENTSNUM);
 }
 
 Epoll::~Epoll() {
@@ -17,11 +18,17 @@ Epoll::~Epoll() {
 }
 
 // 注册新描述符
-void Epoll::epoll_add(const SP_Channel &request) {
+void Epoll::add(const SP_Channel &request) {
     assert(request);
     int fd = request->getFd();
+    if (fd < 0 || fd >= static_cast<int>(fd2chan_.size())) {
+        LOG_ERROR("fd [%d] exceeds poller capacity %zu", fd, fd2chan_.size())
+        return;
+    }
+    assert((reinterpret_cast<uintptr_t>(request.get()) >> 48) == 0);
+    request->nextTag();
     epoll_event event{};
-    event.data.fd = fd;
+    event.data.u64 = encode(request.get());
     event.events = request->getEvents();
 
     request->EqualAndUpdateLastEvents();
@@ -36,15 +43,15 @@ void Epoll::epoll_add(const SP_Channel &request) {
 }
 
 // 修改描述符状态
-void Epoll::epoll_mod(const SP_Channel &request) {
+void Epoll::mod(const SP_Channel &request) {
     int fd = request->getFd();
     if (!request->EqualAndUpdateLastEvents()) {
         epoll_event event{};
-        event.data.fd = fd;
+        event.data.u64 = encode(request.get());
         event.events = request->getEvents();
         if (epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event) < 0) {
+            // 可能在工作线程中调用，不修改fd2chan_，由IO线程注销
             perror("epoll_mod error");
-            fd2chan_[fd].reset();
             LOG_ERROR("Error happened when modifying fd [%d].", fd)
         } else {
             LOG_DEBUG("fd [%d] modified", fd)
@@ -52,11 +59,13 @@ void Epoll::epoll_mod(const SP_Channel &request) {
     }
 }
 
-// 从epoll中删除描述符
-void Epoll::epoll_del(const SP_Channel &request) {
+// 从epoll中删除描述符，须在IO线程中调用
+void Epoll::del(const SP_Channel &request) {
     int fd = request->getFd();
+    if (fd < 0 || fd >= static_cast<int>(fd2chan_.size())) {
+        return;
+    }
     epoll_event event{};
-    event.data.fd = fd;
     event.events = request->getLastEvents();
     if (epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, &event) < 0) {
         perror("epoll_del error");
@@ -64,36 +73,44 @@ void Epoll::epoll_del(const SP_Channel &request) {
     } else {
         LOG_DEBUG("fd [%d] deleted", fd)
     }
+    // 之后的poll中该Channel残留的就绪事件因代数不符而被跳过，本轮尚未处理的事件直接清除
+    request->nextTag();
+    request->setRevents(0);
+    if (fd2chan_[fd]) {
+        retired_.push_back(std::move(fd2chan_[fd]));
+    }
     fd2chan_[fd].reset();
 }
 
-// 返回活跃事件数
-std::vector<SP_Channel> Epoll::poll() {
+// 返回活跃的Channel，分发过程不分配内存、不增减引用计数
+const std::vector<Channel *> &Epoll::poll(bool block) {
+    retired_.clear();
+    ready_.clear();
     while (true) {
-        int event_count = epoll_wait(epollFd, &*events_.begin(), events_.size(), EPOLLWAIT_TIME);
+        int event_count =
+            epoll_wait(epollFd, &*events_.begin(), events_.size(), block ? EPOLLWAIT_TIME : 0);
         if (event_count < 0)
             perror("epoll wait error");
         // LOG_DEBUG("polled and got %d active channels.", event_count)
-        std::vector<SP_Channel> req_data;
         for (int i = 0; i < event_count; ++i) {
-            // 获取有事件产生的描述符
-            int fd = events_[i].data.fd;
-            LOG_DEBUG("fd [%d] active", fd)
-
-            SP_Channel cur_req = fd2chan_[fd];
-
-            if (cur_req) {
-                cur_req->setRevents(events_[i].events);
-                cur_req->setEvents(0);
-                req_data.push_back(cur_req);
-            } else {
-                // LOG << "SP cur_req is invalid";
+            uint64_t data = events_[i].data.u64;
+            auto cur_req = reinterpret_cast<Channel *>(data & ((1ULL << 48) - 1));
+            if (cur_req->getTag() != static_cast<uint16_t>(data >> 48)) {
+                continue;
             }
+            LOG_DEBUG("fd [%d] active", cur_req->getFd())
+            cur_req->setRevents(events_[i].events);
+            cur_req->setEvents(0);
+            ready_.push_back(cur_req);
         }
-        if (!req_data.empty())
-            return req_data;
+        if (!ready_.empty() || !block)
+            return ready_;
     }
 }
+
 std::shared_ptr<Channel> Epoll::getChannel(int fd) {
+    if (fd < 0 || fd >= static_cast<int>(fd2chan_.size())) {
+        return nullptr;
+    }
     return fd2chan_[fd];
 }
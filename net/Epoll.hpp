@@ -4,26 +4,40 @@
 #include <vector>
 #include <memory>
 #include "Channel.hpp"
+#include "Poller.hpp"
 
-class Epoll {
+class Epoll : public Poller {
     int epollFd;
     std::vector<epoll_event> events_;
 
-    static const int MAXFDS = 100000;
+    // 以fd为下标，大小为构造时给定的fd上限
     std::vector<std::shared_ptr<Channel>> fd2chan_;
 
+    // 复用的就绪列表
+    std::vector<Channel *> ready_;
+    // 本轮注销的Channel，延迟到下一次poll时释放，保证本轮就绪列表中的指针有效
+    std::vector<std::shared_ptr<Channel>> retired_;
+
+    // epoll_event.data中低48位存放Channel指针，高16位存放注册代数
+    static uint64_t encode(Channel *channel) {
+        return reinterpret_cast<uintptr_t>(channel)
+            | static_cast<uint64_t>(channel->getTag()) << 48;
+    }
+
 public:
-    explicit Epoll();
+    explicit Epoll(int maxFds = DEFAULT_MAX_FDS);
+
+    ~Epoll() override;
 
-    ~Epoll();
+    void add(const std::shared_ptr<Channel> &request) override;
 
-    void epoll_add(const std::shared_ptr<Channel> &request);
+    void mod(const std::shared_ptr<Channel> &request) override;
 
-    void epoll_mod(const std::shared_ptr<Channel> &request);
+    void del(const std::shared_ptr<Channel> &request) override;
 
-    void epoll_del(const std::shared_ptr<Channel> &request);
+    std::shared_ptr<Channel> getChannel(int fd) override;
 
-    std::shared_ptr<Channel> getChannel(int fd);
+    const std::vector<Channel *> &poll(bool block = true) override;
 
-    std::vector<std::shared_ptr<Channel>> poll();
+    const char *name() const override { return "epoll"; }
 };
@@ -0,0 +1,315 @@
+#include "IoUring.hpp"
+#include "../log/log.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+IoUring::IoUring(unsigned entries, int maxFds) :
+    maxFds_(maxFds), fd2chan_(maxFds), gen_(maxFds), armed_(maxFds), batch_(maxFds) {
+    ready_.reserve(entries);
+    io_uring_params params{};
+    ringFd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (ringFd < 0) {
+        LOG_WARN("io_uring_setup failed: %s", strerror(errno))
+        return;
+    }
+
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMmap) {
+        sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+    }
+    sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd,
+                  IORING_OFF_SQ_RING);
+    cqRing = singleMmap ? sqRing
+                        : mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                               ringFd, IORING_OFF_CQ_RING);
+    sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    sqes = static_cast<io_uring_sqe *>(mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE,
+                                            MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES));
+    if (sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqes == MAP_FAILED) {
+        LOG_WARN("io_uring mmap failed: %s", strerror(errno))
+        close(ringFd);
+        ringFd = -1;
+        return;
+    }
+
+    auto sq = static_cast<char *>(sqRing);
+    sqHead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sqMask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    sqEntries = params.sq_entries;
+
+    auto cq = static_cast<char *>(cqRing);
+    cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cqMask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+    if (!probeMultishot()) {
+        // 单次触发的poll需在每次完成后重新提交，对始终可写的连接会不停触发，不如直接使用epoll
+        LOG_WARN("io_uring multishot poll is not supported by this kernel")
+        close(ringFd);
+        ringFd = -1;
+        return;
+    }
+    LOG_INFO("io_uring ready with %u sq entries", sqEntries)
+}
+
+IoUring::~IoUring() {
+    if (sqes && sqes != MAP_FAILED) {
+        munmap(sqes, sqesSize);
+    }
+    if (cqRing && cqRing != MAP_FAILED && cqRing != sqRing) {
+        munmap(cqRing, cqRingSize);
+    }
+    if (sqRing && sqRing != MAP_FAILED) {
+        munmap(sqRing, sqRingSize);
+    }
+    if (ringFd >= 0) {
+        close(ringFd);
+    }
+}
+
+bool IoUring::probeMultishot() {
+    // 对一个已可读的eventfd提交多次触发的poll请求，等待其第一个完成事件
+    int probeFd = eventfd(1, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (probeFd < 0) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lk(sqMut);
+    io_uring_sqe sqe{};
+    sqe.opcode = IORING_OP_POLL_ADD;
+    sqe.fd = probeFd;
+    sqe.poll32_events = EPOLLIN;
+    sqe.len = IORING_POLL_ADD_MULTI;
+    sqe.user_data = IGNORED;
+    pushSqe(sqe);
+    bool supported = false;
+    if (submit(1) >= 0 && *cqHead != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+        const io_uring_cqe &cqe = cqes[*cqHead & *cqMask];
+        supported = cqe.res > 0 && (cqe.flags & IORING_CQE_F_MORE);
+        __atomic_store_n(cqHead, *cqHead + 1, __ATOMIC_RELEASE);
+    }
+    if (supported) {
+        // 撤销探测请求，其后续完成事件以IGNORED标记，在poll中被跳过
+        io_uring_sqe remove{};
+        remove.opcode = IORING_OP_POLL_REMOVE;
+        remove.fd = -1;
+        remove.addr = IGNORED;
+        remove.user_data = IGNORED;
+        pushSqe(remove);
+        submit(0);
+    }
+    close(probeFd);
+    return supported;
+}
+
+// 注册新描述符
+void IoUring::add(const SP_Channel &request) {
+    assert(request);
+    int fd = request->getFd();
+    if (!inRange(fd)) {
+        LOG_ERROR("fd [%d] exceeds poller capacity %d", fd, maxFds_)
+        return;
+    }
+    request->EqualAndUpdateLastEvents();
+
+    std::lock_guard<std::mutex> lk(sqMut);
+    if (armed_[fd]) {
+        cancelPoll(fd);
+    }
+    fd2chan_[fd] = request;
+    ++gen_[fd];
+    armPoll(fd, request->getEvents());
+    if (std::this_thread::get_id() != loopThread_) {
+        submit(0);
+    }
+    LOG_DEBUG("fd [%d] added to io_uring.", fd)
+}
+
+// 修改描述符状态，EPOLLONESHOT的请求触发后已失效，需要重新提交
+void IoUring::mod(const SP_Channel &request) {
+    int fd = request->getFd();
+    if (!inRange(fd) || request->EqualAndUpdateLastEvents()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lk(sqMut);
+    if (!fd2chan_[fd]) {
+        return;
+    }
+    if (armed_[fd]) {
+        cancelPoll(fd);
+    }
+    ++gen_[fd];
+    armPoll(fd, request->getEvents());
+    if (std::this_thread::get_id() != loopThread_) {
+        submit(0);
+    }
+    LOG_DEBUG("fd [%d] modified", fd)
+}
+
+// 注销描述符，之后到达的旧请求的完成事件会因代数不符而被丢弃
+void IoUring::del(const SP_Channel &request) {
+    int fd = request->getFd();
+    if (!inRange(fd)) {
+        return;
+    }
+    std::lock_guard<std::mutex> lk(sqMut);
+    if (armed_[fd]) {
+        cancelPoll(fd);
+        if (std::this_thread::get_id() != loopThread_) {
+            submit(0);
+        }
+    }
+    ++gen_[fd];
+    // 本轮尚未处理的就绪事件直接清除
+    request->setRevents(0);
+    if (fd2chan_[fd]) {
+        retired_.push_back(std::move(fd2chan_[fd]));
+    }
+    fd2chan_[fd].reset();
+    LOG_DEBUG("fd [%d] deleted", fd)
+}
+
+SP_Channel IoUring::getChannel(int fd) {
+    if (!inRange(fd)) {
+        return nullptr;
+    }
+    return fd2chan_[fd];
+}
+
+const std::vector<Channel *> &IoUring::poll(bool block) {
+    {
+        std::lock_guard<std::mutex> lk(sqMut);
+        retired_.clear();
+    }
+    ready_.clear();
+    while (true) {
+        unsigned pending;
+        {
+            std::lock_guard<std::mutex> lk(sqMut);
+            loopThread_ = std::this_thread::get_id();
+            ++batchId_;
+            unsigned head = *cqHead;
+            unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+            for (; head != tail; ++head) {
+                const io_uring_cqe &cqe = cqes[head & *cqMask];
+                if (cqe.user_data == IGNORED) {
+                    continue;
+                }
+                int fd = static_cast<int>(cqe.user_data & 0xffffffff);
+                auto gen = static_cast<uint32_t>(cqe.user_data >> 32);
+                if (!inRange(fd) || gen != gen_[fd] || !fd2chan_[fd]) {
+                    continue;
+                }
+                bool more = cqe.flags & IORING_CQE_F_MORE;
+                if (!more) {
+                    armed_[fd] = false;
+                }
+                if (cqe.res < 0) {
+                    LOG_ERROR("poll on fd [%d] failed: %s", fd, strerror(-cqe.res))
+                    continue;
+                }
+                Channel *cur_req = fd2chan_[fd].get();
+                if (!more && !(cur_req->getLastEvents() & EPOLLONESHOT)) {
+                    // 持续监听的请求被内核终止，重新提交
+                    ++gen_[fd];
+                    armPoll(fd, cur_req->getLastEvents());
+                }
+                if (batch_[fd] == batchId_) {
+                    cur_req->setRevents(cur_req->getRevents() | cqe.res);
+                } else {
+                    batch_[fd] = batchId_;
+                    cur_req->setRevents(cqe.res);
+                    cur_req->setEvents(0);
+                    ready_.push_back(cur_req);
+                }
+            }
+            __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+            if (!ready_.empty()) {
+                // 本轮处理产生的重新注册请求不必等到下一次等待时才提交
+                if (toSubmit) {
+                    submit(0);
+                }
+                return ready_;
+            }
+            if (!block) {
+                // 非阻塞检查只读取完成队列，有积攒的请求时顺带提交
+                if (toSubmit) {
+                    submit(0);
+                }
+                return ready_;
+            }
+            pending = toSubmit;
+            toSubmit = 0;
+        }
+        // 提交积攒的请求并等待至少一个完成事件，只需一次系统调用
+        int ret = static_cast<int>(
+            syscall(__NR_io_uring_enter, ringFd, pending, 1, IORING_ENTER_GETEVENTS, nullptr, 0));
+        if (ret < 0 && errno != EINTR) {
+            perror("io_uring_enter error");
+        }
+    }
+}
+
+void IoUring::pushSqe(const io_uring_sqe &sqe) {
+    unsigned tail = *sqTail;
+    if (tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries) {
+        // 提交队列已满，先提交已有请求
+        toSubmit = tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+        submit(0);
+        assert(tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) < sqEntries);
+    }
+    unsigned index = tail & *sqMask;
+    sqes[index] = sqe;
+    sqArray[index] = index;
+    // 请求内容写完后再发布队尾，事件循环线程可能在不持锁的情况下提交
+    __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+    ++toSubmit;
+}
+
+void IoUring::armPoll(int fd, uint32_t events) {
+    io_uring_sqe sqe{};
+    sqe.opcode = IORING_OP_POLL_ADD;
+    sqe.fd = fd;
+    sqe.poll32_events = events & ~(EPOLLET | EPOLLONESHOT | EPOLLEXCLUSIVE | EPOLLWAKEUP);
+    if (!(events & EPOLLONESHOT)) {
+        // 多次触发的poll请求语义与边沿触发一致
+        sqe.len = IORING_POLL_ADD_MULTI;
+    }
+    sqe.user_data = userData(fd, gen_[fd]);
+    pushSqe(sqe);
+    armed_[fd] = true;
+}
+
+void IoUring::cancelPoll(int fd) {
+    io_uring_sqe sqe{};
+    sqe.opcode = IORING_OP_POLL_REMOVE;
+    sqe.fd = -1;
+    sqe.addr = userData(fd, gen_[fd]);
+    sqe.user_data = IGNORED;
+    pushSqe(sqe);
+    armed_[fd] = false;
+}
+
+int IoUring::submit(unsigned waitNr) {
+    unsigned flags = waitNr ? IORING_ENTER_GETEVENTS : 0;
+    int ret =
+        static_cast<int>(syscall(__NR_io_uring_enter, ringFd, toSubmit, waitNr, flags, nullptr, 0));
+    if (ret < 0) {
+        if (errno != EINTR) {
+            perror("io_uring_enter error");
+        }
+        return ret;
+    }
+    toSubmit -= std::min(toSubmit, static_cast<unsigned>(ret));
+    return ret;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <linux/io_uring.h>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Channel.hpp"
+#include "Poller.hpp"
+
+// 基于io_uring的后端：以IORING_OP_POLL_ADD代替epoll_ctl注册事件，
+// 注册、修改、注销操作先写入提交队列，由事件循环在等待完成事件的同一次io_uring_enter中批量提交
+class IoUring : public Poller {
+public:
+    explicit IoUring(unsigned entries = 4096, int maxFds = DEFAULT_MAX_FDS);
+
+    ~IoUring() override;
+
+    // io_uring_setup失败（内核不支持或被禁用）或内核不支持多次触发的poll请求时返回false
+    bool valid() const { return ringFd >= 0; }
+
+    void add(const SP_Channel &request) override;
+
+    void mod(const SP_Channel &request) override;
+
+    void del(const SP_Channel &request) override;
+
+    SP_Channel getChannel(int fd) override;
+
+    const std::vector<Channel *> &poll(bool block = true) override;
+
+    const char *name() const override { return "io_uring"; }
+
+private:
+    // POLL_REMOVE等内部操作的完成事件使用该user_data，处理时直接忽略
+    static const uint64_t IGNORED = ~0ULL;
+
+    // fd是否在以fd为下标的表的范围内
+    bool inRange(int fd) const { return fd >= 0 && fd < maxFds_; }
+
+    // 检查内核是否支持IORING_POLL_ADD_MULTI（5.13起），不支持时每个poll请求都以-EINVAL完成
+    bool probeMultishot();
+
+    // 以下函数调用时需持有sqMut
+    void pushSqe(const io_uring_sqe &sqe);
+    void armPoll(int fd, uint32_t events);
+    void cancelPoll(int fd);
+    int submit(unsigned waitNr);
+
+    static uint64_t userData(int fd, uint32_t gen) { return (uint64_t)gen << 32 | (uint32_t)fd; }
+
+    int ringFd;
+
+    // 提交队列
+    void *sqRing = nullptr;
+    size_t sqRingSize = 0;
+    unsigned *sqHead = nullptr;
+    unsigned *sqTail = nullptr;
+    unsigned *sqMask = nullptr;
+    unsigned *sqArray = nullptr;
+    unsigned sqEntries = 0;
+    io_uring_sqe *sqes = nullptr;
+    size_t sqesSize = 0;
+    // 已写入提交队列但尚未提交给内核的数量
+    unsigned toSubmit = 0;
+
+    // 完成队列
+    void *cqRing = nullptr;
+    size_t cqRingSize = 0;
+    unsigned *cqHead = nullptr;
+    unsigned *cqTail = nullptr;
+    unsigned *cqMask = nullptr;
+    io_uring_cqe *cqes = nullptr;
+
+    // 提交队列只允许单生产者，工作线程修改事件时需要加锁
+    std::mutex sqMut;
+    std::thread::id loopThread_;
+
+    // 以下以fd为下标的表大小均为maxFds_
+    int maxFds_;
+    std::vector<SP_Channel> fd2chan_;
+    // 复用的就绪列表
+    std::vector<Channel *> ready_;
+    // 本轮注销的Channel，延迟到下一次poll时释放
+    std::vector<SP_Channel> retired_;
+    // 每个fd当前poll请求的代数，用于丢弃已注销或已替换请求的完成事件
+    std::vector<uint32_t> gen_;
+    // 每个fd的poll请求是否仍在内核中等待
+    std::vector<bool> armed_;
+    // 每个fd最近一次被加入就绪列表的批次，用于合并同一批次中的多次完成事件
+    std::vector<unsigned> batch_;
+    unsigned batchId_ = 0;
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+
+// 有界无锁多生产者多消费者环形队列（Vyukov），元素为指针；
+// 每个槽位带有序号，入队与出队各只需一次CAS，队列满或空时立即返回false
+template <typename T>
+class MpmcRing {
+public:
+    // capacity必须是2的幂
+    explicit MpmcRing(size_t capacity) : mask_(capacity - 1), cells_(new Cell[capacity]) {
+        assert(capacity >= 2 && (capacity & (capacity - 1)) == 0);
+        for (size_t i = 0; i < capacity; i++) {
+            cells_[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpmcRing(const MpmcRing &) = delete;
+    MpmcRing &operator=(const MpmcRing &) = delete;
+
+    bool push(T *item) {
+        size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+        Cell *cell;
+        while (true) {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0) {
+                if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false; // 已满
+            } else {
+                pos = enqueuePos_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->item = item;
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    T *pop() {
+        size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+        Cell *cell;
+        while (true) {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return nullptr; // 为空
+            } else {
+                pos = dequeuePos_.load(std::memory_order_relaxed);
+            }
+        }
+        T *item = cell->item;
+        cell->seq.store(pos + mask_ + 1, std::memory_order_release);
+        return item;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> seq;
+        T *item;
+    };
+
+    const size_t mask_;
+    std::unique_ptr<Cell[]> cells_;
+    // 入队与出队位置分别位于不同缓存行，避免伪共享
+    char pad0_[64];
+    std::atomic<size_t> enqueuePos_{0};
+    char pad1_[64];
+    std::atomic<size_t> dequeuePos_{0};
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+
+// 侵入式无锁多生产者单消费者队列（Vyukov），Node须含有 std::atomic<Node *> next 成员
+// push可在任意线程调用，pop只能由唯一的消费者线程调用；入队出队均不分配内存
+template <typename Node>
+class MpscQueue {
+public:
+    MpscQueue() : head_(&stub_), tail_(&stub_) {
+        stub_.next.store(nullptr, std::memory_order_relaxed);
+    }
+
+    MpscQueue(const MpscQueue &) = delete;
+    MpscQueue &operator=(const MpscQueue &) = delete;
+
+    void push(Node *node) {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        Node *prev = head_.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    // 队列为空，或生产者尚未完成链接时返回nullptr
+    Node *pop() {
+        Node *tail = tail_;
+        Node *next = tail->next.load(std::memory_order_acquire);
+        if (tail == &stub_) {
+            if (!next) {
+                return nullptr;
+            }
+            tail_ = next;
+            tail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if (next) {
+            tail_ = next;
+            return tail;
+        }
+        if (tail != head_.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        push(&stub_);
+        next = tail->next.load(std::memory_order_acquire);
+        if (next) {
+            tail_ = next;
+            return tail;
+        }
+        return nullptr;
+    }
+
+    // 任意线程均可调用，结果仅作参考
+    bool empty() const { return head_.load(std::memory_order_acquire) == &stub_; }
+
+private:
+    // 生产者与消费者访问的字段分处不同缓存行
+    std::atomic<Node *> head_;
+    char pad_[64];
+    Node *tail_;
+    Node stub_;
+};
@@ -0,0 +1,17 @@
+#include "Poller.hpp"
+#include "Epoll.hpp"
+#include "IoUring.hpp"
+#include "../log/log.h"
+
+const int Poller::DEFAULT_MAX_FDS;
+
+std::shared_ptr<Poller> Poller::create(Backend backend, int maxFds) {
+    if (backend == IO_URING) {
+        auto ring = std::make_shared<IoUring>(4096, maxFds);
+        if (ring->valid()) {
+            return ring;
+        }
+        LOG_WARN("io_uring is unavailable, falling back to epoll")
+    }
+    return std::make_shared<Epoll>(maxFds);
+}
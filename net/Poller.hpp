@@ -0,0 +1,37 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "Channel.hpp"
+
+// IO多路复用后端的统一接口，Reactor通过该接口注册、修改、注销Channel并等待事件
+class Poller {
+public:
+    enum Backend {
+        EPOLL,
+        IO_URING,
+    };
+
+    // 默认的fd上限，以fd为下标的表按此大小分配
+    static const int DEFAULT_MAX_FDS = 100000;
+
+    virtual ~Poller() = default;
+
+    virtual void add(const SP_Channel &request) = 0;
+
+    virtual void mod(const SP_Channel &request) = 0;
+
+    virtual void del(const SP_Channel &request) = 0;
+
+    virtual SP_Channel getChannel(int fd) = 0;
+
+    // block为true时阻塞直到有活跃的Channel，否则只检查一次，没有就绪事件时返回空列表；
+    // 返回的列表由Poller复用，在下一次poll前有效，其中的Channel在下一次poll前不会被析构
+    virtual const std::vector<Channel *> &poll(bool block = true) = 0;
+
+    virtual const char *name() const = 0;
+
+    // 创建指定后端，若该后端在当前内核上不可用则回退到epoll；只能注册小于maxFds的fd
+    static std::shared_ptr<Poller> create(Backend backend, int maxFds = DEFAULT_MAX_FDS);
+};
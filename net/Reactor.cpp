@@ -1,70 +1,203 @@
 #include "Reactor.hpp"
 
+#include <sys/timerfd.h>
+
 #include "../log/log.h"
+#include "../base/Clock.hpp"
+
+Reactor::Reactor(int threadNum, Poller::Backend backend, int maxFds) :
+    threadPool(threadNum > 0 ? std::make_shared<ThreadPool>(threadNum) : nullptr),
+    poller(Poller::create(backend, maxFds)),
+    timer_(std::make_shared<TimingWheel>()), looping_(false), quit_(false) {
+    init();
+}
 
-Reactor::Reactor(int threadNum) :
-    threadPool(std::make_shared<ThreadPool>(threadNum)), poller(std::make_shared<Epoll>()),
-    pendingList(std::make_shared<PendingList>()), looping_(false), quit_(false) {
+Reactor::Reactor(std::shared_ptr<ThreadPool> threadPool_, Poller::Backend backend, int maxFds) :
+    threadPool(std::move(threadPool_)), poller(Poller::create(backend, maxFds)),
+    timer_(std::make_shared<TimingWheel>()), looping_(false), quit_(false) {
+    init();
+}
+
+Reactor::~Reactor() {
+    while (auto node = pendingTasks.pop()) {
+        delete node;
+    }
+    while (auto node = freeTasks_.pop()) {
+        delete node;
+    }
+    close(wakeupChannel->getFd());
+    close(timerChannel->getFd());
+}
+
+void Reactor::init() {
     int ret = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    assert(ret > 0);
     wakeupChannel = std::make_shared<Channel>(ret);
     wakeupChannel->setEvents(EPOLLIN);
     wakeupChannel->setReadHandler([ret] {
-        char buf;
+        uint64_t buf;
         read(ret, &buf, sizeof(buf));
     });
     addToPoller(wakeupChannel);
+
+    // 每个Reactor拥有独立的定时器，超时连接由其所属的IO线程清理
+    int timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    assert(timerFd > 0);
+    timerChannel = std::make_shared<Channel>(timerFd);
+    timerChannel->setEvents(EPOLLIN);
+    timerChannel->setReadHandler([this] { handleTimer(); });
+    itimerspec new_value{timespec{1}, timespec{1}};
+    timerfd_settime(timerFd, 0, &new_value, nullptr);
+    addToPoller(timerChannel);
+}
+
+void Reactor::handleTimer() {
+    uint64_t buf;
+    read(timerChannel->getFd(), &buf, sizeof(buf));
+    auto nextTick = timer_->getNextTick();
+    if (nextTick < 0) {
+        return;
+    }
+    // 下一次在时间轮最近的非空槽到期时触发，之后新加入的定时器最迟由1秒的周期触发处理
+    itimerspec new_value{timespec{1, 0}, timespec{nextTick / 1000, (nextTick % 1000) * 1000000}};
+    timerfd_settime(timerChannel->getFd(), 0, &new_value, nullptr);
 }
 
 void Reactor::loop() {
     assert(!looping_);
     looping_ = true;
-    quit_ = false;
-    std::vector<SP_Channel> ret;
+    threadId_ = std::this_thread::get_id();
+    if (!cpus_.empty() && !NumaTopology::bindThread(cpus_)) {
+        LOG_WARN("failed to bind loop to node %d", numaNode_)
+    }
     count = 0;
-    int wakeFd = wakeupChannel->getFd();
     LOG_DEBUG("loop started!")
     while (!quit_) {
-        ret.clear();
-        ret = poller->poll();
-        doPendingTasks();
-        for (auto &it : ret) {
+        const auto &active = busyPollUs_ > 0 ? busyPoll() : poller->poll();
+        // 本轮事件处理使用同一个缓存的时间
+        CoarseClock::update();
+        for (Channel *it : active) {
             LOG_DEBUG("handling fd[%d] at loop %d", it->getFd(), count)
             it->handleEvents();
         }
+        // 事件处理过程中投递的任务在本轮一并执行，无需再次唤醒
+        doPendingTasks();
         ++count;
     }
     looping_ = false;
 }
 
+const std::vector<Channel *> &Reactor::busyPoll() {
+    auto start = std::chrono::steady_clock::now();
+    int budget = spinBudgetUs_.load(std::memory_order_relaxed);
+    if (budget > 0) {
+        auto deadline = start + std::chrono::microseconds(budget);
+        while (true) {
+            const auto &active = poller->poll(false);
+            auto now = std::chrono::steady_clock::now();
+            if (!active.empty() || now >= deadline) {
+                auto spin = std::chrono::duration_cast<std::chrono::nanoseconds>(now - start);
+                spinNs_.fetch_add(spin.count(), std::memory_order_relaxed);
+                if (!active.empty()) {
+                    spinHits_.fetch_add(1, std::memory_order_relaxed);
+                    updateSpinBudget(now - start);
+                    return active;
+                }
+                break;
+            }
+        }
+        spinMisses_.fetch_add(1, std::memory_order_relaxed);
+    }
+    const auto &active = poller->poll();
+    updateSpinBudget(std::chrono::steady_clock::now() - start);
+    return active;
+}
+
+void Reactor::updateSpinBudget(std::chrono::steady_clock::duration gap) {
+    auto gapUs = std::chrono::duration<double, std::micro>(gap).count();
+    gapEwmaUs_ = gapEwmaUs_ * 0.875 + gapUs * 0.125;
+    // 事件通常在两倍平均间隔内到达；平均间隔超过自旋上限时自旋多半落空，直接阻塞，
+    // 阻塞等待的时长同样计入平均值，流量变密时预算会重新恢复
+    auto budget = static_cast<int>(gapEwmaUs_ * 2) + 1;
+    spinBudgetUs_.store(budget <= busyPollUs_ ? budget : 0, std::memory_order_relaxed);
+}
+
+Reactor::BusyPollStats Reactor::busyPollStats() const {
+    BusyPollStats ret;
+    ret.hits = spinHits_.load(std::memory_order_relaxed);
+    ret.misses = spinMisses_.load(std::memory_order_relaxed);
+    ret.spinUs = spinNs_.load(std::memory_order_relaxed) / 1000;
+    ret.budgetUs = spinBudgetUs_.load(std::memory_order_relaxed);
+    return ret;
+}
+
 void Reactor::quit() {
     quit_ = true;
-    close(wakeupChannel->getFd());
+    wakeup();
 }
 
 void Reactor::doPendingTasks() {
-    std::vector<std::function<void()>> tempList;
-    {
-        std::lock_guard<std::mutex> lk(pendingList->mut);
-        tempList.swap(pendingList->tasks);
-    }
-    for (auto &task : tempList) {
+    // 先清除标记再取任务，之后投递的任务会重新唤醒
+    wakeupPending_.store(false, std::memory_order_seq_cst);
+    callingPendingTasks_ = true;
+    // 执行期间投递的任务（如分批接受连接时的后续任务）留到下一轮，避免IO事件被饿死
+    for (auto n = pendingCount_.load(std::memory_order_relaxed); n > 0; --n) {
+        PendingTask *node = pendingTasks.pop();
+        if (!node) {
+            break;
+        }
+        pendingCount_.fetch_sub(1, std::memory_order_relaxed);
         LOG_DEBUG("doing pending tasks in loop %d", count)
-        task();
+        node->task();
+        freePendingTask(node);
     }
+    callingPendingTasks_ = false;
 }
 
 std::shared_ptr<Channel> Reactor::getChannel(int fd) {
     return poller->getChannel(fd);
 }
 
-void Reactor::appendToThreadPool(std::function<void()> &&task) {
-    threadPool->append(std::move(task));
+void Reactor::appendToThreadPool(Task &&task, ThreadPool::Priority priority) {
+    if (threadPool) {
+        threadPool->append(std::move(task), priority);
+    } else {
+        task();
+    }
 }
 
-void Reactor::addPendingTask(std::function<void()> &&task) {
-    {
-        std::lock_guard<std::mutex> lk(pendingList->mut);
-        pendingList->tasks.emplace_back(std::move(task));
+void Reactor::addPendingTask(Task &&task) {
+    pendingCount_.fetch_add(1, std::memory_order_relaxed);
+    pendingTasks.push(newPendingTask(std::move(task)));
+    // IO线程自身在事件处理中投递的任务在本轮循环末尾执行；
+    // 其他线程的连续投递只需一次唤醒，执行待处理任务期间投递的任务需唤醒下一轮
+    if ((!isInLoopThread() || callingPendingTasks_)
+        && !wakeupPending_.exchange(true, std::memory_order_seq_cst)) {
+        wakeup();
+    }
+}
+
+Reactor::PendingTask *Reactor::newPendingTask(Task &&task) {
+    PendingTask *node = freeTasks_.pop();
+    if (!node) {
+        ALLOC_SCOPE(TASK);
+        return new PendingTask(std::move(task));
+    }
+    node->task = std::move(task);
+    return node;
+}
+
+void Reactor::freePendingTask(PendingTask *node) {
+    node->task.reset();
+    if (!freeTasks_.push(node)) {
+        delete node;
+    }
+}
+
+void Reactor::runInLoop(Task &&task) {
+    if (isInLoopThread()) {
+        task();
+    } else {
+        addPendingTask(std::move(task));
     }
-    wakeup();
 }
@@ -4,32 +4,83 @@
 #include <sys/eventfd.h>
 #include <unistd.h>
 #include <cassert>
+#include <thread>
+#include <algorithm>
+#include <chrono>
 
 #include "ThreadPool.hpp"
-#include "Epoll.hpp"
+#include "MpscQueue.hpp"
+#include "MpmcRing.hpp"
+#include "Poller.hpp"
 #include "Channel.hpp"
+#include "../base/TimingWheel.hpp"
 
 class Reactor {
-    class PendingList {
-    public:
-        // 队列
-        std::vector<std::function<void()>> tasks;
-        // 任务队列的读写锁
-        std::mutex mut;
+    struct PendingTask {
+        PendingTask() = default;
+        explicit PendingTask(Task &&t) : task(std::move(t)) {}
+        std::atomic<PendingTask *> next{nullptr};
+        Task task;
     };
 
-    std::shared_ptr<PendingList> pendingList;
+    // 其他线程投递到本IO线程的任务，无锁多生产者单消费者队列
+    MpscQueue<PendingTask> pendingTasks;
+    // 执行完的任务节点，投递时优先取用，不必每次分配
+    MpmcRing<PendingTask> freeTasks_{1024};
+    // 已有尚未处理的唤醒时，后续投递不再写eventfd
+    std::atomic<bool> wakeupPending_{false};
+    // 已投递的任务数，doPendingTasks只执行开始时已投递的任务
+    std::atomic<size_t> pendingCount_{0};
+    bool callingPendingTasks_ = false;
     std::shared_ptr<ThreadPool> threadPool;
-    std::shared_ptr<Epoll> poller;
+    std::shared_ptr<Poller> poller;
+    std::shared_ptr<TimingWheel> timer_;
 
     std::shared_ptr<Channel> wakeupChannel;
+    std::shared_ptr<Channel> timerChannel;
 
     bool looping_;
-    bool quit_;
+    std::atomic<bool> quit_;
+    std::thread::id threadId_;
     unsigned long long count = 0;
 
+    // 当前挂在该Reactor上的连接数，供最小负载分发使用
+    std::atomic<int> load_{0};
+
+    // 忙轮询：阻塞等待前先以非阻塞方式轮询一段时间，时长上限为busyPollUs_，
+    // 实际预算根据事件到达间隔的指数加权平均自适应调整
+    int busyPollUs_ = 0;
+    std::atomic<int> spinBudgetUs_{0};
+    double gapEwmaUs_ = 0;
+    std::atomic<uint64_t> spinHits_{0};
+    std::atomic<uint64_t> spinMisses_{0};
+    std::atomic<uint64_t> spinNs_{0};
+
+    // 所在NUMA节点的下标及IO线程允许运行的CPU，cpus_为空时不绑定
+    int numaNode_ = -1;
+    std::vector<int> cpus_;
+
 public:
-    explicit Reactor(int threadNum = 20);
+    struct BusyPollStats {
+        // 自旋期间等到事件的次数
+        uint64_t hits = 0;
+        // 自旋预算耗尽后转入阻塞等待的次数
+        uint64_t misses = 0;
+        // 自旋消耗的CPU时间（微秒）
+        uint64_t spinUs = 0;
+        // 当前自旋预算（微秒）
+        int budgetUs = 0;
+    };
+
+    // maxFds为可注册的fd上限，决定Poller中以fd为下标的表的大小
+    explicit Reactor(int threadNum = 20, Poller::Backend backend = Poller::EPOLL,
+                     int maxFds = Poller::DEFAULT_MAX_FDS);
+
+    // 多个Reactor共享同一线程池；threadPool为空时任务直接在IO线程中执行
+    explicit Reactor(std::shared_ptr<ThreadPool> threadPool,
+                     Poller::Backend backend = Poller::EPOLL, int maxFds = Poller::DEFAULT_MAX_FDS);
+
+    ~Reactor();
 
     void loop();
 
@@ -37,23 +88,73 @@ public:
 
     std::shared_ptr<Channel> getChannel(int fd);
 
-    void appendToThreadPool(std::function<void()> &&task);
+    std::shared_ptr<TimingWheel> getTimer() const { return timer_; }
+
+    // priority为任务在线程池中的优先级
+    void appendToThreadPool(Task &&task, ThreadPool::Priority priority = ThreadPool::NORMAL);
+
+    // 线程池为空时返回nullptr
+    std::shared_ptr<ThreadPool> getThreadPool() const { return threadPool; }
+
+    void addPendingTask(Task &&task);
+
+    // 在IO线程中调用时立即执行，否则加入待执行队列
+    void runInLoop(Task &&task);
+
+    bool isInLoopThread() const { return threadId_ == std::this_thread::get_id(); }
+
+    int getLoad() const { return load_; }
+    void incLoad() { ++load_; }
+    void decLoad() { --load_; }
 
-    void addPendingTask(std::function<void()> &&task);
+    const char *getPollerName() const { return poller->name(); }
 
-    void removeFromPoller(const std::shared_ptr<Channel> &channel) { poller->epoll_del(channel); }
+    // 开启忙轮询，maxSpinUs为单次自旋的时间上限，为0时关闭；需在loop()前调用
+    void setBusyPoll(int maxSpinUs) {
+        busyPollUs_ = std::max(maxSpinUs, 0);
+        spinBudgetUs_ = busyPollUs_;
+    }
+
+    BusyPollStats busyPollStats() const;
+
+    // 设置所在NUMA节点，IO线程在loop()开始时绑定到cpus；需在loop()前调用
+    void setPlacement(int node, std::vector<int> cpus) {
+        numaNode_ = node;
+        cpus_ = std::move(cpus);
+    }
+
+    // 未设置时返回-1
+    int numaNode() const { return numaNode_; }
+
+    void removeFromPoller(const std::shared_ptr<Channel> &channel) { poller->del(channel); }
     void updatePoller(const std::shared_ptr<Channel> &channel, int timeout = 0) {
-        poller->epoll_mod(channel);
+        poller->mod(channel);
     }
     void addToPoller(const std::shared_ptr<Channel> &channel, int timeout = 0) {
-        poller->epoll_add(channel);
+        poller->add(channel);
     }
 
 private:
+    void init();
+
     void wakeup() {
-        char buf;
-        write(wakeupChannel->getFd(), &buf, sizeof buf);
+        uint64_t one = 1;
+        write(wakeupChannel->getFd(), &one, sizeof one);
     }
 
+    void handleTimer();
+
+    // 先自旋轮询再阻塞等待
+    const std::vector<Channel *> &busyPoll();
+
+    // 根据本次等待事件的时长更新自旋预算
+    void updateSpinBudget(std::chrono::steady_clock::duration gap);
+
     void doPendingTasks();
-};
\ No newline at end of file
+
+    // 取一个空闲的任务节点，没有时才分配
+    PendingTask *newPendingTask(Task &&task);
+
+    // 执行完的任务节点放回空闲列表，空闲列表已满时释放
+    void freePendingTask(PendingTask *node);
+};
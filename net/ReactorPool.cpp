@@ -0,0 +1,78 @@
+#include "ReactorPool.hpp"
+
+#include "../log/log.h"
+
+ReactorPool::ReactorPool(int reactorNum, const std::shared_ptr<ThreadPool> &threadPool,
+                         Policy policy, Poller::Backend backend, int maxFds) :
+    ReactorPool(reactorNum, std::vector<std::shared_ptr<ThreadPool>>{threadPool}, policy,
+                backend, maxFds) {}
+
+ReactorPool::ReactorPool(int reactorNum,
+                         const std::vector<std::shared_ptr<ThreadPool>> &threadPools,
+                         Policy policy, Poller::Backend backend, int maxFds) :
+    policy_(policy) {
+    assert(reactorNum > 0 && !threadPools.empty());
+    for (int i = 0; i < reactorNum; i++) {
+        reactors.push_back(
+            std::make_shared<Reactor>(threadPools[i % threadPools.size()], backend, maxFds));
+    }
+}
+
+ReactorPool::~ReactorPool() {
+    stop();
+}
+
+void ReactorPool::start() {
+    assert(!started_);
+    started_ = true;
+    for (auto &reactor : reactors) {
+        threads.emplace_back([reactor] { reactor->loop(); });
+    }
+    LOG_INFO("%d sub reactors started", (int)reactors.size())
+}
+
+void ReactorPool::stop() {
+    if (!started_) {
+        return;
+    }
+    started_ = false;
+    for (auto &reactor : reactors) {
+        reactor->quit();
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    threads.clear();
+}
+
+std::shared_ptr<Reactor> ReactorPool::getNext() {
+    assert(!reactors.empty());
+    if (policy_ == LEAST_LOADED) {
+        auto ret = reactors[0];
+        for (auto &reactor : reactors) {
+            if (reactor->getLoad() < ret->getLoad()) {
+                ret = reactor;
+            }
+        }
+        return ret;
+    }
+    return reactors[next_++ % reactors.size()];
+}
+
+std::shared_ptr<Reactor> ReactorPool::getNext(int node) {
+    std::shared_ptr<Reactor> ret;
+    unsigned start = next_++;
+    for (size_t i = 0; i < reactors.size(); i++) {
+        auto &reactor = reactors[(start + i) % reactors.size()];
+        if (reactor->numaNode() != node) {
+            continue;
+        }
+        if (policy_ == ROUND_ROBIN) {
+            return reactor;
+        }
+        if (!ret || reactor->getLoad() < ret->getLoad()) {
+            ret = reactor;
+        }
+    }
+    return ret ? ret : getNext();
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <memory>
+#include <thread>
+#include <vector>
+#include <atomic>
+
+#include "Reactor.hpp"
+
+// 子Reactor池，每个子Reactor运行在独立线程中（one loop per thread）
+class ReactorPool {
+public:
+    // 新连接分发策略
+    enum Policy {
+        ROUND_ROBIN,
+        LEAST_LOADED,
+    };
+
+    // threadPool为所有子Reactor共享的工作线程池，为空时请求在IO线程中直接处理
+    ReactorPool(int reactorNum, const std::shared_ptr<ThreadPool> &threadPool,
+                Policy policy = ROUND_ROBIN, Poller::Backend backend = Poller::EPOLL,
+                int maxFds = Poller::DEFAULT_MAX_FDS);
+
+    // 第i个子Reactor使用threadPools[i % threadPools.size()]，用于每个NUMA节点一个线程池
+    ReactorPool(int reactorNum, const std::vector<std::shared_ptr<ThreadPool>> &threadPools,
+                Policy policy = ROUND_ROBIN, Poller::Backend backend = Poller::EPOLL,
+                int maxFds = Poller::DEFAULT_MAX_FDS);
+
+    ~ReactorPool();
+
+    // 启动所有子Reactor的事件循环线程
+    void start();
+
+    // 停止所有子Reactor并等待线程退出
+    void stop();
+
+    // 按分发策略选取一个子Reactor
+    std::shared_ptr<Reactor> getNext();
+
+    // 只在指定NUMA节点的子Reactor中选取，没有该节点的子Reactor时退化为getNext()
+    std::shared_ptr<Reactor> getNext(int node);
+
+    const std::vector<std::shared_ptr<Reactor>> &getReactors() const { return reactors; }
+
+private:
+    Policy policy_;
+    bool started_ = false;
+    std::atomic<unsigned> next_{0};
+    std::vector<std::shared_ptr<Reactor>> reactors;
+    std::vector<std::thread> threads;
+};
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "../base/AllocStats.hpp"
+
+// 只可移动的任务对象，可调用对象不超过内联缓冲区大小时不进行堆分配
+class Task {
+public:
+    static const size_t BUF_SIZE = 48;
+
+    Task() noexcept = default;
+
+    template <typename Func,
+              typename = typename std::enable_if<
+                  !std::is_same<typename std::decay<Func>::type, Task>::value>::type>
+    Task(Func &&func) { // NOLINT 允许由lambda隐式构造
+        using F = typename std::decay<Func>::type;
+        // 在编译期选择存储方式，放不下的可调用对象不会实例化内联构造的代码
+        using FitsInline = std::integral_constant<
+            bool, sizeof(F) <= BUF_SIZE && alignof(F) <= alignof(std::max_align_t)
+                      && std::is_nothrow_move_constructible<F>::value>;
+        construct<F>(std::forward<Func>(func), FitsInline());
+    }
+
+    Task(Task &&other) noexcept { moveFrom(other); }
+
+    Task &operator=(Task &&other) noexcept {
+        if (this != &other) {
+            reset();
+            moveFrom(other);
+        }
+        return *this;
+    }
+
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+
+    ~Task() { reset(); }
+
+    explicit operator bool() const { return ops_ != nullptr; }
+
+    void operator()() { ops_->invoke(buf_); }
+
+    void reset() {
+        if (ops_) {
+            ops_->destroy(buf_);
+            ops_ = nullptr;
+        }
+    }
+
+private:
+    template <typename F, typename Func>
+    void construct(Func &&func, std::true_type) {
+        new (buf_) F(std::forward<Func>(func));
+        ops_ = &inlineOps<F>;
+    }
+    template <typename F, typename Func>
+    void construct(Func &&func, std::false_type) {
+        ALLOC_SCOPE(TASK);
+        *reinterpret_cast<F **>(buf_) = new F(std::forward<Func>(func));
+        ops_ = &heapOps<F>;
+    }
+
+    struct Ops {
+        void (*invoke)(void *);
+        void (*move)(void *dst, void *src);
+        void (*destroy)(void *);
+    };
+
+    template <typename F>
+    static void inlineInvoke(void *p) {
+        (*static_cast<F *>(p))();
+    }
+    template <typename F>
+    static void inlineMove(void *dst, void *src) {
+        new (dst) F(std::move(*static_cast<F *>(src)));
+        static_cast<F *>(src)->~F();
+    }
+    template <typename F>
+    static void inlineDestroy(void *p) {
+        static_cast<F *>(p)->~F();
+    }
+
+    template <typename F>
+    static void heapInvoke(void *p) {
+        (**static_cast<F **>(p))();
+    }
+    static void heapMove(void *dst, void *src) {
+        *static_cast<void **>(dst) = *static_cast<void **>(src);
+    }
+    template <typename F>
+    static void heapDestroy(void *p) {
+        delete *static_cast<F **>(p);
+    }
+
+    template <typename F>
+    static const Ops inlineOps;
+    template <typename F>
+    static const Ops heapOps;
+
+    void moveFrom(Task &other) {
+        ops_ = other.ops_;
+        if (ops_) {
+            ops_->move(buf_, other.buf_);
+            other.ops_ = nullptr;
+        }
+    }
+
+    alignas(std::max_align_t) unsigned char buf_[BUF_SIZE];
+    const Ops *ops_ = nullptr;
+};
+
+template <typename F>
+const Task::Ops Task::inlineOps = {&Task::inlineInvoke<F>, &Task::inlineMove<F>,
+                                   &Task::inlineDestroy<F>};
+
+template <typename F>
+const Task::Ops Task::heapOps = {&Task::heapInvoke<F>, &Task::heapMove, &Task::heapDestroy<F>};
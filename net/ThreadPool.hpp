@@ -1,81 +1,566 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <condition_variable>
 #include <cstdio>
 #include <exception>
 #include <functional>
 #include <iostream>
-#include <list>
 #include <memory>
 #include <mutex>
 #include <thread>
 #include <vector>
 #include <atomic>
+#include <chrono>
+
+#include "Task.hpp"
+#include "MpscQueue.hpp"
+#include "MpmcRing.hpp"
+#include "WorkStealingQueue.hpp"
+#include "../base/Numa.hpp"
 
 //#include "Debug.hpp"
 
-// 线程池类
+// 工作窃取线程池类
+// 每个工作线程拥有一个无锁的本地双端队列及一个无锁收件箱：
+// 外部线程（如Reactor）提交的任务轮询投递到各线程的收件箱，工作线程自身提交的任务直接压入本地队列，
+// 空闲线程从其他线程本地队列的队首窃取任务，整个提交路径不经过全局锁
+// 任务按优先级分入不同通道，每个通道有各自的本地队列与收件箱，
+// 工作线程按权重轮流取各通道的任务，高优先级先执行但低优先级不会被饿死
+// 线程数在[minThreads, maxThreads]之间伸缩：监控线程定期采样任务的排队时间与工作线程利用率，
+// 排队变长且线程忙碌时启用更多线程，长时间空闲时将编号最大的线程挂起，挂起的线程不再参与调度
 class ThreadPool {
 public:
-    // 参数thread_number是线程池中线程的数量
-    explicit ThreadPool(int thread_number) : pool(std::make_shared<Pool>()) {
-        for (int i = 0; i < thread_number; i++) {
-            std::thread([pool_ = pool, i] {
-                std::unique_lock<std::mutex> lk(pool_->mut);
-                while (true) {
-                    pool_->cond.wait(lk, [&pool_] { return !pool_->tasks.empty() || pool_->isClosed; });
-                    if (pool_->isClosed) {
-                        break;
-                    }
-                    auto task = pool_->tasks.front();
-                    pool_->tasks.pop_front();
-                    lk.unlock();
-                    task();
-                    lk.lock();
-                }
-                printf("thread %d ended\n", i);
-            }).detach();
+    // 任务优先级，Server中依次用于完成写出、处理已读入的请求与读取新数据
+    enum Priority {
+        HIGH,
+        NORMAL,
+        LOW,
+        PRIORITIES,
+    };
+
+    // 排队时间直方图的桶数，第i个桶统计排队时间小于2^i微秒的任务，最后一个桶不设上限
+    static const int WAIT_BUCKETS = 20;
+
+    typedef std::array<int, PRIORITIES> Weights;
+
+    struct Stats {
+        // 排队中的任务数
+        size_t queued = 0;
+        // 已执行的任务数
+        uint64_t executed = 0;
+        // 当前参与调度的线程数及已创建的线程数
+        int active = 0;
+        int spawned = 0;
+        // 扩容与缩容的次数
+        uint64_t grows = 0;
+        uint64_t shrinks = 0;
+        // 通过窃取获得的任务数
+        uint64_t steals = 0;
+        // 各优先级排队中的任务数
+        std::array<size_t, PRIORITIES> laneQueued{};
+        // 各优先级的排队时间直方图
+        std::array<std::array<uint64_t, WAIT_BUCKETS>, PRIORITIES> waitHist{};
+    };
+
+    struct Options {
+        // 线程数的上下限
+        int minThreads = 1;
+        int maxThreads = 1;
+        // 每个优先级本地队列的容量，须为2的幂
+        size_t queueCapacity = 4096;
+        // 每轮调度中各优先级最多执行的任务数
+        Weights weights{{4, 2, 1}};
+        // 平均排队时间超过该值（微秒）且线程忙碌时扩容
+        int targetWaitUs = 500;
+        // 利用率持续偏低超过该时长（毫秒）后开始缩容
+        int idleMs = 2000;
+        // 监控线程的采样间隔（毫秒）
+        int intervalMs = 10;
+        // 工作线程允许运行的CPU，为空时不绑定
+        std::vector<int> cpus;
+    };
+
+    // 参数thread_number是线程池中线程的数量，线程数固定不伸缩
+    explicit ThreadPool(int thread_number, size_t queueCapacity = 4096,
+                        Weights weights = Weights{{4, 2, 1}}) :
+        ThreadPool(fixed(thread_number, queueCapacity, weights)) {}
+
+    explicit ThreadPool(const Options &options) : pool(std::make_shared<Pool>()) {
+        assert(options.minThreads > 0 && options.maxThreads >= options.minThreads);
+        pool->options = options;
+        for (auto &weight : pool->options.weights) {
+            weight = std::max(weight, 1);
+        }
+        for (int i = 0; i < options.maxThreads; i++) {
+            pool->workers.emplace_back(new Worker(pool.get(), i, options.queueCapacity));
+        }
+        // 线程在首次启用时才创建
+        for (int i = 0; i < options.minThreads; i++) {
+            spawn(pool, i);
+        }
+        pool->active.store(options.minThreads, std::memory_order_release);
+        if (options.maxThreads > options.minThreads) {
+            pool->supervisor = std::thread([pool_ = pool] { supervise(pool_); });
         }
     }
     ~ThreadPool() {
-        //{
-        //    std::lock_guard<std::mutex> lk(pool->mut);
-        //    pool->isClosed = true;
-        //}
         pool->isClosed = true;
-        pool->cond.notify_all();
+        {
+            std::lock_guard<std::mutex> lk(pool->superMut);
+            pool->superCond.notify_one();
+        }
+        if (pool->supervisor.joinable()) {
+            pool->supervisor.join();
+        }
+        for (auto &worker : pool->workers) {
+            worker->notify();
+        }
+        for (auto &worker : pool->workers) {
+            if (!worker->thread.joinable()) {
+                continue;
+            }
+            // 线程池可能由其中一个工作线程执行的任务释放，该线程无法等待自身
+            if (worker->thread.get_id() == std::this_thread::get_id()) {
+                worker->thread.detach();
+            } else {
+                worker->thread.join();
+            }
+        }
     }
 
     // 往请求队列中添加任务
 
     template <typename Func>
-    bool append(Func &&task);
+    bool append(Func &&task, Priority priority = NORMAL);
+
+    Stats stats() const;
+
+    // 当前参与调度的线程数
+    int size() const { return pool->active.load(std::memory_order_relaxed); }
+
+    int minSize() const { return pool->options.minThreads; }
+    int maxSize() const { return pool->options.maxThreads; }
+
+    // 直方图第bucket个桶的上限（微秒），最后一个桶返回-1
+    static long long bucketLimitUs(int bucket) {
+        return bucket + 1 < WAIT_BUCKETS ? 1LL << bucket : -1;
+    }
 
 private:
-    class Pool {
-    public:
-        // 队列
-        std::list<std::function<void()>> tasks;
-        // 任务队列的读写锁
+    typedef std::chrono::steady_clock Clock;
+
+    struct TaskNode {
+        TaskNode() = default;
+        explicit TaskNode(Task &&t) : task(std::move(t)) {}
+        std::atomic<TaskNode *> next{nullptr};
+        Task task;
+        Priority priority = NORMAL;
+        // 入队时间，用于统计排队时间
+        Clock::time_point enqueued;
+    };
+
+    class Pool;
+
+    // 单个优先级的任务通道
+    struct Lane {
+        explicit Lane(size_t capacity) : local(capacity) {}
+
+        // 本地任务队列，只有本线程压入与弹出，其他线程可窃取
+        WorkStealingQueue<TaskNode> local;
+        // 收件箱，接收外部线程提交的任务
+        MpscQueue<TaskNode> inbox;
+        std::atomic<size_t> inboxSize{0};
+    };
+
+    struct Worker {
+        Worker(Pool *owner_, int id_, size_t capacity) : owner(owner_), id(id_) {
+            for (auto &lane : lanes) {
+                lane.reset(new Lane(capacity));
+            }
+        }
+
+        // 唤醒该线程
+        void notify() {
+            std::lock_guard<std::mutex> lk(mut);
+            wakeup = true;
+            cond.notify_one();
+        }
+
+        // 与append中先增加inboxSize再读取sleeping的顺序配对，两侧均为seq_cst才不会丢失唤醒
+        bool hasInbox() const {
+            for (auto &lane : lanes) {
+                if (lane->inboxSize.load(std::memory_order_seq_cst) > 0) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        Pool *owner;
+        int id;
+        std::unique_ptr<Lane> lanes[PRIORITIES];
+        std::atomic<bool> sleeping{false};
         std::mutex mut;
-        // 任务队列的条件变量
         std::condition_variable cond;
+        bool wakeup = false;
+        // 本轮调度中各优先级剩余的执行次数，只由本线程访问
+        Weights credits{};
+        // 只由监控线程及析构函数访问
+        std::thread thread;
+        // 统计计数与上面的调度字段隔开，避免伪共享
+        char pad_[64];
+        std::atomic<uint64_t> executed{0};
+        std::atomic<uint64_t> steals{0};
+        // 执行任务累计耗时与排队时间之和，供监控线程计算利用率与平均排队时间
+        std::atomic<uint64_t> busyNs{0};
+        std::atomic<uint64_t> waitUs{0};
+        std::atomic<uint64_t> waitHist[PRIORITIES][WAIT_BUCKETS]{};
+    };
+
+    class Pool {
+    public:
+        ~Pool() {
+            while (TaskNode *node = freeNodes.pop()) {
+                delete node;
+            }
+        }
+
+        // 取一个空闲的任务节点，没有时才分配
+        TaskNode *newNode(Task &&task) {
+            TaskNode *node = freeNodes.pop();
+            if (!node) {
+                ALLOC_SCOPE(TASK);
+                return new TaskNode(std::move(task));
+            }
+            node->task = std::move(task);
+            return node;
+        }
+
+        // 执行完的任务节点放回空闲列表，空闲列表已满时释放
+        void freeNode(TaskNode *node) {
+            node->task.reset();
+            if (!freeNodes.push(node)) {
+                delete node;
+            }
+        }
+
+        // 按maxThreads预先创建，编号小于active的线程参与调度，其余挂起或尚未创建
+        std::vector<std::unique_ptr<Worker>> workers;
+        Options options;
+        std::atomic<int> active{0};
+        std::atomic<int> spawned{0};
+        std::atomic<uint64_t> grows{0};
+        std::atomic<uint64_t> shrinks{0};
+        std::thread supervisor;
+        std::mutex superMut;
+        std::condition_variable superCond;
+        // 空闲的任务节点，由提交任务的线程取出、执行任务的线程放回，稳定运行时提交任务不分配内存
+        MpmcRing<TaskNode> freeNodes{4096};
+        // 处于睡眠状态的线程数
+        std::atomic<int> sleepers{0};
         // 线程池是否析构
         std::atomic<bool> isClosed{false};
     };
 
+    // 当前线程所属的工作线程，外部线程为nullptr
+    static Worker *&currentWorker() {
+        static thread_local Worker *worker = nullptr;
+        return worker;
+    }
+
+    static Options fixed(int threads, size_t queueCapacity, const Weights &weights) {
+        Options options;
+        options.minThreads = options.maxThreads = threads;
+        options.queueCapacity = queueCapacity;
+        options.weights = weights;
+        return options;
+    }
+
+    static void spawn(const std::shared_ptr<Pool> &pool, int i);
+    static void supervise(const std::shared_ptr<Pool> &self);
+    static void run(Pool &pool, Worker &self);
+    static bool park(Pool &pool, Worker &self);
+    static TaskNode *findTask(Pool &pool, Worker &self);
+    static TaskNode *takeLocal(Pool &pool, Worker &self, int priority);
+    static void execute(Pool &pool, Worker &self, TaskNode *node);
+    static void wakeIdle(Pool &pool);
+
     std::shared_ptr<Pool> pool;
 };
 
 template <typename Func>
-bool ThreadPool::append(Func &&task) {
-    if (!pool) {
+bool ThreadPool::append(Func &&task, Priority priority) {
+    if (!pool || pool->isClosed) {
+        return false;
+    }
+    auto node = pool->newNode(Task(std::forward<Func>(task)));
+    node->priority = priority;
+    node->enqueued = Clock::now();
+    Worker *self = currentWorker();
+    if (self && self->owner == pool.get() && self->lanes[priority]->local.push(node)) {
+        // 工作线程提交的后续任务留在本地，由空闲线程窃取
+        wakeIdle(*pool);
+        return true;
+    }
+    // 外部线程按线程局部计数轮询选择目标，避免共享计数器
+    static thread_local unsigned next = 0;
+    auto &target = *pool->workers[next++ % pool->active.load(std::memory_order_acquire)];
+    auto &lane = *target.lanes[priority];
+    lane.inbox.push(node);
+    lane.inboxSize.fetch_add(1, std::memory_order_seq_cst);
+    if (target.sleeping.load(std::memory_order_seq_cst)) {
+        target.notify();
+    } else {
+        wakeIdle(*pool);
+    }
+    return true;
+}
+
+inline ThreadPool::Stats ThreadPool::stats() const {
+    Stats ret;
+    for (auto &worker : pool->workers) {
+        for (int p = 0; p < PRIORITIES; p++) {
+            auto &lane = *worker->lanes[p];
+            auto queued = lane.local.size() + lane.inboxSize.load(std::memory_order_relaxed);
+            ret.laneQueued[p] += queued;
+            ret.queued += queued;
+            for (int b = 0; b < WAIT_BUCKETS; b++) {
+                ret.waitHist[p][b] += worker->waitHist[p][b].load(std::memory_order_relaxed);
+            }
+        }
+        ret.executed += worker->executed.load(std::memory_order_relaxed);
+        ret.steals += worker->steals.load(std::memory_order_relaxed);
+    }
+    ret.active = pool->active.load(std::memory_order_relaxed);
+    ret.spawned = pool->spawned.load(std::memory_order_relaxed);
+    ret.grows = pool->grows.load(std::memory_order_relaxed);
+    ret.shrinks = pool->shrinks.load(std::memory_order_relaxed);
+    return ret;
+}
+
+inline void ThreadPool::spawn(const std::shared_ptr<Pool> &pool, int i) {
+    auto &worker = *pool->workers[i];
+    if (worker.thread.joinable()) {
+        return;
+    }
+    worker.thread = std::thread([pool_ = pool, i] {
+        if (!pool_->options.cpus.empty()) {
+            NumaTopology::bindThread(pool_->options.cpus);
+        }
+        run(*pool_, *pool_->workers[i]);
+        printf("thread %d ended\n", i);
+    });
+    pool->spawned.fetch_add(1, std::memory_order_relaxed);
+}
+
+inline void ThreadPool::supervise(const std::shared_ptr<Pool> &self) {
+    auto &pool = *self;
+    auto &options = pool.options;
+    auto interval = std::chrono::milliseconds(options.intervalMs);
+    int idleLimit = std::max(options.idleMs / std::max(options.intervalMs, 1), 1);
+    int idleTicks = 0;
+    uint64_t lastBusyNs = 0, lastWaitUs = 0, lastExecuted = 0;
+    auto last = Clock::now();
+    while (!pool.isClosed) {
+        {
+            std::unique_lock<std::mutex> lk(pool.superMut);
+            pool.superCond.wait_for(lk, interval, [&pool] { return pool.isClosed.load(); });
+        }
+        if (pool.isClosed) {
+            break;
+        }
+        uint64_t busyNs = 0, waitUs = 0, executed = 0;
+        size_t queued = 0;
+        for (auto &worker : pool.workers) {
+            busyNs += worker->busyNs.load(std::memory_order_relaxed);
+            waitUs += worker->waitUs.load(std::memory_order_relaxed);
+            executed += worker->executed.load(std::memory_order_relaxed);
+            for (auto &lane : worker->lanes) {
+                queued += lane->local.size() + lane->inboxSize.load(std::memory_order_relaxed);
+            }
+        }
+        auto now = Clock::now();
+        auto elapsedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(now - last).count();
+        last = now;
+        int active = pool.active.load(std::memory_order_relaxed);
+        // 利用率：采样间隔内执行任务的时间占全部参与调度线程时间的比例
+        double util = elapsedNs > 0 ? double(busyNs - lastBusyNs) / (double(elapsedNs) * active) : 0;
+        auto done = executed - lastExecuted;
+        double avgWaitUs = done > 0 ? double(waitUs - lastWaitUs) / done : 0;
+        lastBusyNs = busyNs;
+        lastWaitUs = waitUs;
+        lastExecuted = executed;
+
+        // 任务排队变长（或线程被长任务占满、队列仍在积压）时扩容，每次最多增加四分之一
+        bool congested = util >= 0.75 && (avgWaitUs > options.targetWaitUs || queued > (size_t)active);
+        if (congested && active < options.maxThreads) {
+            int grow = std::min(std::max(active / 4, 1), options.maxThreads - active);
+            for (int i = active; i < active + grow; i++) {
+                spawn(self, i);
+            }
+            pool.active.store(active + grow, std::memory_order_release);
+            for (int i = active; i < active + grow; i++) {
+                pool.workers[i]->notify();
+            }
+            pool.grows.fetch_add(1, std::memory_order_relaxed);
+            idleTicks = 0;
+            continue;
+        }
+        if (util < 0.3 && avgWaitUs < options.targetWaitUs / 4.0) {
+            // 空闲持续idleMs后每个采样间隔挂起一个线程，直到利用率回升或降到下限
+            if (++idleTicks >= idleLimit && active > options.minThreads) {
+                pool.active.store(active - 1, std::memory_order_release);
+                pool.workers[active - 1]->notify();
+                pool.shrinks.fetch_add(1, std::memory_order_relaxed);
+            }
+        } else {
+            idleTicks = 0;
+        }
+    }
+}
+
+inline void ThreadPool::wakeIdle(Pool &pool) {
+    // 本地队列的push不是seq_cst，入队与读取sleepers之间需要全屏障；与run中增加sleepers后的屏障配对，
+    // 空闲线程要么在再次查找时看到任务，要么在这里被看到并唤醒
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (pool.sleepers.load(std::memory_order_seq_cst) == 0) {
+        return;
+    }
+    int active = pool.active.load(std::memory_order_acquire);
+    for (int i = 0; i < active; i++) {
+        auto &worker = *pool.workers[i];
+        // sleeping先于sleepers写入，看到sleepers后也能看到sleeping
+        if (worker.sleeping.load(std::memory_order_seq_cst)) {
+            worker.notify();
+            return;
+        }
+    }
+}
+
+inline void ThreadPool::execute(Pool &pool, Worker &self, TaskNode *node) {
+    auto waitUs =
+        std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - node->enqueued).count();
+    int bucket = 0;
+    while (bucket + 1 < WAIT_BUCKETS && waitUs >= (1LL << bucket)) {
+        bucket++;
+    }
+    self.waitHist[node->priority][bucket].fetch_add(1, std::memory_order_relaxed);
+    self.waitUs.fetch_add(waitUs, std::memory_order_relaxed);
+    auto start = Clock::now();
+    node->task();
+    pool.freeNode(node);
+    self.busyNs.fetch_add(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count(),
+        std::memory_order_relaxed);
+    self.executed.fetch_add(1, std::memory_order_relaxed);
+}
+
+inline ThreadPool::TaskNode *ThreadPool::takeLocal(Pool &pool, Worker &self, int priority) {
+    auto &lane = *self.lanes[priority];
+    TaskNode *node = lane.local.pop();
+    if (node) {
+        return node;
+    }
+    // 将收件箱中的任务转移到本地队列，使其可以被其他线程窃取
+    while (lane.inboxSize.load(std::memory_order_acquire) > 0) {
+        TaskNode *item = lane.inbox.pop();
+        if (!item) {
+            break; // 生产者尚未完成入队
+        }
+        lane.inboxSize.fetch_sub(1, std::memory_order_relaxed);
+        if (!node) {
+            node = item;
+        } else if (!lane.local.push(item)) {
+            // 本地队列已满，直接执行
+            execute(pool, self, item);
+        }
+    }
+    return node;
+}
+
+inline ThreadPool::TaskNode *ThreadPool::findTask(Pool &pool, Worker &self) {
+    // 加权轮转：每轮中各优先级最多执行weights个任务，按优先级从高到低选取；
+    // 仍有剩余次数的优先级都没有任务时开始新的一轮
+    for (int round = 0; round < 2; round++) {
+        for (int p = 0; p < PRIORITIES; p++) {
+            if (self.credits[p] <= 0) {
+                continue;
+            }
+            TaskNode *node = takeLocal(pool, self, p);
+            if (node) {
+                self.credits[p]--;
+                return node;
+            }
+        }
+        self.credits = pool.options.weights;
+    }
+    // 挂起的线程本地队列中可能还留有任务，一并窃取
+    auto n = static_cast<size_t>(pool.spawned.load(std::memory_order_acquire));
+    for (int p = 0; p < PRIORITIES; p++) {
+        for (size_t i = 1; i < n; i++) {
+            auto &victim = *pool.workers[(self.id + i) % n];
+            TaskNode *node = victim.lanes[p]->local.steal();
+            if (node) {
+                self.steals.fetch_add(1, std::memory_order_relaxed);
+                return node;
+            }
+        }
+    }
+    return nullptr;
+}
+
+inline bool ThreadPool::park(Pool &pool, Worker &self) {
+    if (self.id < pool.active.load(std::memory_order_acquire)) {
         return false;
     }
-    {
-        std::lock_guard<std::mutex> lk(pool->mut);
-        pool->tasks.emplace_back(std::forward<Func>(task));
+    // 先执行挂起前已提交到本线程的任务，挂起期间投递到收件箱的任务同样由本线程执行
+    for (int p = 0; p < PRIORITIES; p++) {
+        if (TaskNode *node = takeLocal(pool, self, p)) {
+            execute(pool, self, node);
+            return true;
+        }
     }
-    pool->cond.notify_one();
+    std::unique_lock<std::mutex> lk(self.mut);
+    self.sleeping.store(true, std::memory_order_seq_cst);
+    // 挂起后投递到收件箱的任务由append看到sleeping后唤醒，恢复运行由监控线程修改active后唤醒
+    self.cond.wait(lk, [&self, &pool] {
+        return self.wakeup || pool.isClosed || self.hasInbox()
+            || self.id < pool.active.load(std::memory_order_acquire);
+    });
+    self.wakeup = false;
+    self.sleeping.store(false, std::memory_order_seq_cst);
     return true;
 }
+
+inline void ThreadPool::run(Pool &pool, Worker &self) {
+    currentWorker() = &self;
+    while (!pool.isClosed) {
+        if (park(pool, self)) {
+            continue;
+        }
+        TaskNode *node = findTask(pool, self);
+        if (!node) {
+            self.sleeping.store(true, std::memory_order_seq_cst);
+            pool.sleepers.fetch_add(1, std::memory_order_seq_cst);
+            // 进入睡眠前再检查一次，避免丢失唤醒：与wakeIdle中的屏障配对
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            node = findTask(pool, self);
+            if (!node) {
+                std::unique_lock<std::mutex> lk(self.mut);
+                self.cond.wait(lk, [&self, &pool] {
+                    return self.wakeup || pool.isClosed || self.hasInbox();
+                });
+                self.wakeup = false;
+            }
+            pool.sleepers.fetch_sub(1, std::memory_order_seq_cst);
+            self.sleeping.store(false, std::memory_order_seq_cst);
+            if (!node) {
+                continue;
+            }
+        }
+        execute(pool, self, node);
+    }
+    currentWorker() = nullptr;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// 定长无锁工作窃取双端队列（Chase-Lev）
+// push/pop只能由所属线程在队尾调用，steal可由任意线程在队首调用
+template <typename T>
+class WorkStealingQueue {
+public:
+    explicit WorkStealingQueue(size_t capacity = 4096) :
+        mask_(capacity - 1), buffer_(new std::atomic<T *>[capacity]) {
+        assert(capacity > 0 && (capacity & (capacity - 1)) == 0);
+    }
+
+    WorkStealingQueue(const WorkStealingQueue &) = delete;
+    WorkStealingQueue &operator=(const WorkStealingQueue &) = delete;
+
+    // 队列已满时返回false
+    bool push(T *item) {
+        int64_t b = bottom_.load(std::memory_order_relaxed);
+        int64_t t = top_.load(std::memory_order_acquire);
+        if (b - t > static_cast<int64_t>(mask_)) {
+            return false;
+        }
+        buffer_[b & mask_].store(item, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom_.store(b + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    T *pop() {
+        int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+        bottom_.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top_.load(std::memory_order_relaxed);
+        if (t > b) {
+            bottom_.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        T *item = buffer_[b & mask_].load(std::memory_order_relaxed);
+        if (t == b) {
+            // 最后一个元素，与窃取者竞争
+            if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                              std::memory_order_relaxed)) {
+                item = nullptr;
+            }
+            bottom_.store(b + 1, std::memory_order_relaxed);
+        }
+        return item;
+    }
+
+    T *steal() {
+        int64_t t = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom_.load(std::memory_order_acquire);
+        if (t >= b) {
+            return nullptr;
+        }
+        T *item = buffer_[t & mask_].load(std::memory_order_relaxed);
+        if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                          std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return item;
+    }
+
+    // 任意线程均可调用，结果仅作参考
+    size_t size() const {
+        int64_t b = bottom_.load(std::memory_order_relaxed);
+        int64_t t = top_.load(std::memory_order_relaxed);
+        return b > t ? static_cast<size_t>(b - t) : 0;
+    }
+
+    bool empty() const { return size() == 0; }
+
+private:
+    // 窃取者与所属线程访问的字段分处不同缓存行
+    std::atomic<int64_t> top_{0};
+    char pad_[64];
+    std::atomic<int64_t> bottom_{0};
+    const size_t mask_;
+    std::unique_ptr<std::atomic<T *>[]> buffer_;
+};
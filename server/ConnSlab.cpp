@@ -0,0 +1,59 @@
+#include "ConnSlab.hpp"
+
+#include <sys/mman.h>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <new>
+
+#include "../base/Numa.hpp"
+#include "../log/log.h"
+
+ConnSlab::ConnSlab(int capacity, int prealloc, int node) :
+    capacity_(capacity), conns_(capacity), channels_(capacity), used_(capacity) {
+    assert(capacity > 0);
+    // 只保留地址空间，未使用的槽不占用物理内存
+    mapSize_ = sizeof(Slot) * capacity;
+    void *mem = mmap(nullptr, mapSize_, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mem == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+    slots_ = static_cast<Slot *>(mem);
+    if (node >= 0 && !NumaTopology::get().bindMemory(mem, mapSize_, node)) {
+        LOG_WARN("mbind conn slab to node %d failed: %s", node, strerror(errno))
+    }
+    for (int fd = 0; fd < std::min(prealloc, capacity); fd++) {
+        construct(fd);
+    }
+}
+
+ConnSlab::~ConnSlab() {
+    for (int fd = 0; fd < capacity_; fd++) {
+        if (conns_[fd]) {
+            // 放弃槽的引用但不减少计数，Channel处理器释放引用后计数停留在1，不会delete槽内对象
+            conns_[fd].detach();
+            channels_[fd].reset();
+            slots_[fd].~Slot();
+        }
+    }
+    munmap(slots_, mapSize_);
+}
+
+void ConnSlab::construct(int fd) {
+    auto slot = new (&slots_[fd]) Slot(fd);
+    conns_[fd] = SP_HttpConn(&slot->conn);
+    // Channel的控制块在槽的生命周期内只分配一次，删除器为空操作，内存由munmap统一释放
+    channels_[fd] = std::shared_ptr<Channel>(&slot->channel, [](Channel *) {});
+    ++constructed_;
+}
+
+ConnSlab::Slot &ConnSlab::acquire(int fd, bool *firstUse) {
+    assert(fd >= 0 && fd < capacity_);
+    if (!conns_[fd]) {
+        construct(fd);
+    }
+    *firstUse = !used_[fd];
+    used_[fd] = true;
+    return slots_[fd];
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "../http/HttpConn.hpp"
+#include "../net/Channel.hpp"
+
+// 以fd为下标的固定容量连接槽
+// 每个槽中的HttpConn与Channel构造在同一块按缓存行对齐的内存中，槽在fd首次使用时构造（或启动时预先构造），
+// 连接关闭后保留，fd复用时重置使用，接受连接的路径上不再分配内存
+class ConnSlab {
+public:
+    struct alignas(64) Slot {
+        explicit Slot(int fd) : channel(fd) {}
+        HttpConn conn;
+        Channel channel;
+    };
+
+    // capacity为可容纳的最大fd，prealloc为启动时预先构造的槽数，
+    // node不小于0时槽的内存优先分配在该NUMA节点（NumaTopology中的下标）上
+    explicit ConnSlab(int capacity, int prealloc = 0, int node = -1);
+
+    ~ConnSlab();
+
+    ConnSlab(const ConnSlab &) = delete;
+    ConnSlab &operator=(const ConnSlab &) = delete;
+
+    // 返回fd对应的槽，firstUse为true表示该槽首次被使用，调用者需完成一次性的设置（如Channel的处理器）
+    Slot &acquire(int fd, bool *firstUse);
+
+    // 以下两个函数只能在fd对应的槽构造之后调用
+    const SP_HttpConn &conn(int fd) const { return conns_[fd]; }
+    const std::shared_ptr<Channel> &channel(int fd) const { return channels_[fd]; }
+
+    int capacity() const { return capacity_; }
+
+    // 已构造的槽数
+    int constructed() const { return constructed_; }
+
+    // 每个槽连同下标表项占用的字节数
+    static size_t slotBytes() {
+        return sizeof(Slot) + sizeof(SP_HttpConn) + sizeof(std::shared_ptr<Channel>);
+    }
+
+private:
+    void construct(int fd);
+
+    Slot *slots_;
+    size_t mapSize_;
+    int capacity_;
+    int constructed_ = 0;
+    // 槽本身持有HttpConn的一份引用，因此其计数不会降为0；
+    // Channel的shared_ptr不负责释放内存，使其可以沿用Poller的接口
+    std::vector<SP_HttpConn> conns_;
+    std::vector<std::shared_ptr<Channel>> channels_;
+    std::vector<bool> used_;
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+
+class Reactor;
+
+// 以fd为下标的连接表，每个表项带有代数：连接建立与关闭时各递增一次，奇数表示连接存活
+// 其他线程可以用(fd, 代数)安全地判断连接是否仍是当初的那一个，fd复用后旧的引用自动失效
+class ConnTable {
+public:
+    struct Handle {
+        int fd = -1;
+        uint32_t gen = 0;
+    };
+
+    explicit ConnTable(int capacity) : capacity_(capacity), entries_(new Entry[capacity]) {
+        assert(capacity > 0);
+    }
+
+    // 记录新连接及其所属的Reactor，返回连接的句柄；只由接受连接的线程调用
+    Handle insert(int fd, Reactor *loop) {
+        assert(fd >= 0 && fd < capacity_);
+        auto &entry = entries_[fd];
+        assert(!(entry.gen.load(std::memory_order_relaxed) & 1));
+        entry.loop.store(loop, std::memory_order_relaxed);
+        auto gen = entry.gen.fetch_add(1, std::memory_order_release) + 1;
+        int high = highWater_.load(std::memory_order_relaxed);
+        while (fd >= high
+               && !highWater_.compare_exchange_weak(high, fd + 1, std::memory_order_relaxed)) {
+        }
+        live_.fetch_add(1, std::memory_order_relaxed);
+        return {fd, gen};
+    }
+
+    // 连接关闭时调用，必须在关闭fd之前完成
+    void remove(int fd) {
+        auto &entry = entries_[fd];
+        assert(entry.gen.load(std::memory_order_relaxed) & 1);
+        entry.gen.fetch_add(1, std::memory_order_release);
+        live_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // 句柄对应的连接是否仍然存活
+    bool alive(Handle handle) const {
+        return handle.fd >= 0 && handle.fd < capacity_
+            && entries_[handle.fd].gen.load(std::memory_order_acquire) == handle.gen
+            && (handle.gen & 1);
+    }
+
+    Handle handle(int fd) const { return {fd, entries_[fd].gen.load(std::memory_order_acquire)}; }
+
+    // 连接所属的Reactor，连接关闭后保留最后一次的值
+    Reactor *loop(int fd) const { return entries_[fd].loop.load(std::memory_order_relaxed); }
+
+    int liveCount() const { return live_.load(std::memory_order_relaxed); }
+
+    int capacity() const { return capacity_; }
+
+    static size_t entryBytes() { return sizeof(Entry); }
+
+    // 遍历当前存活的连接，只扫描曾经使用过的最大fd以内的表项；
+    // 遍历期间连接可能关闭，需要访问连接时应通过alive()再次确认
+    template <typename Func>
+    void forEachLive(Func &&func) const {
+        int high = highWater_.load(std::memory_order_relaxed);
+        for (int fd = 0; fd < high; fd++) {
+            auto gen = entries_[fd].gen.load(std::memory_order_acquire);
+            if (gen & 1) {
+                func(Handle{fd, gen}, loop(fd));
+            }
+        }
+    }
+
+private:
+    struct Entry {
+        std::atomic<uint32_t> gen{0};
+        std::atomic<Reactor *> loop{nullptr};
+    };
+
+    int capacity_;
+    std::unique_ptr<Entry[]> entries_;
+    std::atomic<int> highWater_{0};
+    std::atomic<int> live_{0};
+};
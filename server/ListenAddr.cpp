@@ -0,0 +1,104 @@
+#include "ListenAddr.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/un.h>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+
+// 解析1-65535的端口号
+static bool parsePort(const std::string &text, in_port_t *port) {
+    if (text.empty() || text.size() > 5) {
+        return false;
+    }
+    char *end;
+    long value = strtol(text.c_str(), &end, 10);
+    if (*end != '\0' || value < 1 || value > 65535) {
+        return false;
+    }
+    *port = htons(static_cast<uint16_t>(value));
+    return true;
+}
+
+bool ListenAddr::parse(const std::string &spec, ListenAddr *out) {
+    ListenAddr ret;
+    ret.text = spec;
+    if (spec.compare(0, 5, "unix:") == 0) {
+        auto name = spec.substr(5);
+        auto un = reinterpret_cast<sockaddr_un *>(&ret.addr);
+        if (name.empty() || name.size() >= sizeof(un->sun_path)) {
+            return false;
+        }
+        un->sun_family = AF_UNIX;
+        memcpy(un->sun_path, name.data(), name.size());
+        if (name[0] == '@') {
+            // 抽象命名空间以'\0'开头，地址长度不包含结尾的'\0'
+            un->sun_path[0] = '\0';
+            ret.len = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + name.size());
+        } else {
+            ret.len = sizeof(sockaddr_un);
+        }
+        *out = ret;
+        return true;
+    }
+    if (!spec.empty() && spec[0] == '[') {
+        auto close = spec.find("]:");
+        if (close == std::string::npos) {
+            return false;
+        }
+        auto in6 = reinterpret_cast<sockaddr_in6 *>(&ret.addr);
+        in6->sin6_family = AF_INET6;
+        if (inet_pton(AF_INET6, spec.substr(1, close - 1).c_str(), &in6->sin6_addr) != 1
+            || !parsePort(spec.substr(close + 2), &in6->sin6_port)) {
+            return false;
+        }
+        ret.len = sizeof(sockaddr_in6);
+        *out = ret;
+        return true;
+    }
+    auto in = reinterpret_cast<sockaddr_in *>(&ret.addr);
+    in->sin_family = AF_INET;
+    in->sin_addr.s_addr = htonl(INADDR_ANY);
+    auto colon = spec.rfind(':');
+    std::string port = spec;
+    if (colon != std::string::npos) {
+        port = spec.substr(colon + 1);
+        auto host = spec.substr(0, colon);
+        if (!host.empty() && inet_pton(AF_INET, host.c_str(), &in->sin_addr) != 1) {
+            return false;
+        }
+    }
+    if (!parsePort(port, &in->sin_port)) {
+        return false;
+    }
+    ret.len = sizeof(sockaddr_in);
+    *out = ret;
+    return true;
+}
+
+std::string ListenAddr::path() const {
+    if (family() != AF_UNIX) {
+        return "";
+    }
+    auto un = reinterpret_cast<const sockaddr_un *>(&addr);
+    if (un->sun_path[0] == '\0') {
+        return "";
+    }
+    return std::string(un->sun_path, strnlen(un->sun_path, sizeof(un->sun_path)));
+}
+
+std::string ListenAddr::format(const sockaddr_storage &addr) {
+    char ip[INET6_ADDRSTRLEN] = "?";
+    if (addr.ss_family == AF_INET) {
+        auto in = reinterpret_cast<const sockaddr_in *>(&addr);
+        inet_ntop(AF_INET, &in->sin_addr, ip, sizeof(ip));
+        return std::string(ip) + ":" + std::to_string(ntohs(in->sin_port));
+    }
+    if (addr.ss_family == AF_INET6) {
+        auto in6 = reinterpret_cast<const sockaddr_in6 *>(&addr);
+        inet_ntop(AF_INET6, &in6->sin6_addr, ip, sizeof(ip));
+        return "[" + std::string(ip) + "]:" + std::to_string(ntohs(in6->sin6_port));
+    }
+    return "unix";
+}
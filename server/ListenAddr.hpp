@@ -0,0 +1,31 @@
+#pragma once
+
+#include <sys/socket.h>
+#include <string>
+
+// 监听地址，支持IPv4、IPv6与Unix域套接字（文件路径或抽象命名空间），格式：
+//   8080 或 :8080          所有IPv4地址
+//   127.0.0.1:8080          指定IPv4地址
+//   [::]:8080               所有IPv6地址，同时接受IPv4连接（双栈）
+//   [::1]:8080              指定IPv6地址
+//   unix:/run/ws.sock       Unix域套接字，绑定前删除同名的残留套接字文件
+//   unix:@ws                抽象命名空间中的Unix域套接字，不在文件系统中创建文件
+struct ListenAddr {
+    sockaddr_storage addr{};
+    socklen_t len = 0;
+    // 解析前的原始字符串，用于日志与统计输出
+    std::string text;
+
+    int family() const { return addr.ss_family; }
+
+    bool isTcp() const { return family() == AF_INET || family() == AF_INET6; }
+
+    // 文件系统中的Unix域套接字路径，其他地址返回空串
+    std::string path() const;
+
+    // 解析失败时返回false
+    static bool parse(const std::string &spec, ListenAddr *out);
+
+    // 将accept得到的对端地址格式化为"ip:port"，Unix域套接字返回"unix"
+    static std::string format(const sockaddr_storage &addr);
+};
@@ -1,18 +1,47 @@
 #include "Server.hpp"
 
+#include "../http/FileCache.hpp"
 #include "../http/HttpConn.hpp"
 #include "../log/log.h"
+#include "../base/AllocStats.hpp"
+#include "../base/Clock.hpp"
 
 #include <fcntl.h>  // fcntl()
 #include <unistd.h> // close()
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h> // sched_getaffinity()
+#include <sys/prctl.h>
+#include <sys/resource.h> // setrlimit()
+#include <sys/signalfd.h>
 #include <sys/socket.h>
+#include <sys/stat.h> // stat()
+#include <netinet/tcp.h> // TCP_DEFER_ACCEPT, TCP_FASTOPEN, TCP_INFO
+#include <sys/wait.h>
 #include <thread>
+#include <chrono>
 #include <cstdio>
 #include <iostream>
 
 Server::Server(int _port, int _threadNum, int _timeoutMS, bool openLog, int logLevel) :
-    port(_port), timeoutMS(_timeoutMS), reactor(std::make_shared<Reactor>(_threadNum)),
-    heapTimer(std::make_unique<HeapTimer>()) {
+    Server([&] {
+        ServerOptions opts;
+        opts.port = _port;
+        opts.threadNum = _threadNum;
+        opts.timeoutMS = _timeoutMS;
+        opts.openLog = openLog;
+        opts.logLevel = logLevel;
+        return opts;
+    }()) {}
+
+Server::Server(const ServerOptions &_options) :
+    options(_options), port(_options.port), timeoutMS(_options.timeoutMS),
+    conns_(std::min(std::max(_options.maxConnections, 1), TimingWheel::DEFAULT_CAPACITY)) {
+    options.maxConnections = conns_.capacity();
+    deadlineMs_[HttpConn::HEADER_TIMEOUT] = options.headerTimeoutMs;
+    deadlineMs_[HttpConn::BODY_TIMEOUT] = options.bodyTimeoutMs;
+    deadlineMs_[HttpConn::IDLE_TIMEOUT] = timeoutMS;
+    deadlineMs_[HttpConn::WRITE_TIMEOUT] = options.writeTimeoutMs;
     srcDir = getcwd(nullptr, 256);
     assert(srcDir);
     strncat(srcDir, "/resources/", 16);
@@ -21,244 +50,1054 @@ Server::Server(int _port, int _threadNum, int _timeoutMS, bool openLog, int logL
     HttpConn::isET = true;
 
     listenEvent_ = EPOLLRDHUP;
-    connEvent_ = EPOLLONESHOT | EPOLLRDHUP;
+    connEvent_ = EPOLLIN | EPOLLOUT | EPOLLRDHUP;
 
     listenEvent_ |= EPOLLET;
     connEvent_ |= EPOLLET;
-
-    if (openLog) {
-        Log::Instance()->init(logLevel, "./log", ".log", 1024);
-        LOG_DEBUG("Server init finished")
-    }
 }
 
 Server::~Server() {
-    reactor->quit();
+    stopLoops();
+    closeListeners();
     isClosed = true;
     free(srcDir);
     LOG_DEBUG("Server quited.")
 }
 
+void Server::initLog(const char *suffix) {
+    if (options.openLog) {
+        Log::Instance()->init(options.logLevel, "./log", suffix, 1024);
+        LOG_DEBUG("Server init finished")
+    }
+}
+
+ThreadPool::Options Server::poolOptions(int cpus) const {
+    ThreadPool::Options poolOptions;
+    // 任务中包含读取文件等可能阻塞的操作，上限为CPU数的两倍
+    poolOptions.maxThreads = options.threadNum > 0 ? options.threadNum : 2 * cpus;
+    poolOptions.minThreads = options.minThreads > 0 ? options.minThreads : std::max(cpus / 4, 1);
+    poolOptions.minThreads = std::min(poolOptions.minThreads, poolOptions.maxThreads);
+    poolOptions.weights = options.laneWeights;
+    poolOptions.targetWaitUs = options.poolTargetWaitUs;
+    poolOptions.idleMs = options.poolIdleMs;
+    return poolOptions;
+}
+
+void Server::initReactors() {
+    // 连接的fd均小于maxConnections，监听套接字等在启动时创建的fd编号较小，不低于默认上限即可覆盖
+    int pollerFds = std::max(options.maxConnections, Poller::DEFAULT_MAX_FDS);
+    if (options.numa && workerId_ >= 0) {
+        // 多进程模式下各worker已绑定到单个CPU
+        LOG_WARN("numa placement is ignored in worker processes")
+        options.numa = false;
+    }
+    if (options.numa) {
+        // 每个节点一个线程池，线程数按节点的CPU数确定；子Reactor依次分配到各节点
+        auto &topology = NumaTopology::get();
+        int nodes = topology.nodeCount();
+        std::vector<std::shared_ptr<ThreadPool>> threadPools;
+        for (int node = 0; node < nodes; node++) {
+            std::shared_ptr<ThreadPool> threadPool;
+            if (options.threadNum != 0) {
+                auto opts = poolOptions(static_cast<int>(topology.cpus(node).size()));
+                opts.cpus = topology.cpus(node);
+                threadPool = std::make_shared<ThreadPool>(opts);
+            }
+            threadPools.push_back(threadPool);
+        }
+        int reactorNum = std::max(options.subReactorNum, nodes);
+        reactor = std::make_shared<Reactor>(nullptr, options.ioBackend, pollerFds);
+        subReactors = std::unique_ptr<ReactorPool>(new ReactorPool(
+            reactorNum, threadPools, options.dispatchPolicy, options.ioBackend, pollerFds));
+        auto &loops = subReactors->getReactors();
+        for (int i = 0; i < reactorNum; i++) {
+            loops[i]->setPlacement(i % nodes, topology.cpus(i % nodes));
+        }
+        LOG_INFO("numa placement: %d nodes, %d sub reactors", nodes, reactorNum)
+    } else {
+        std::shared_ptr<ThreadPool> threadPool;
+        if (options.threadNum != 0) {
+            // 多进程模式下各worker平分CPU
+            int cpus = static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+            if (workerId_ >= 0 && options.workerProcesses > 0) {
+                cpus = std::max(cpus / options.workerProcesses, 1);
+            } else if (workerId_ >= 0) {
+                cpus = 1;
+            }
+            threadPool = std::make_shared<ThreadPool>(poolOptions(cpus));
+        }
+        if (options.subReactorNum > 0) {
+            // 多Reactor模式：主Reactor只负责接受连接，连接IO由子Reactor完成
+            reactor = std::make_shared<Reactor>(nullptr, options.ioBackend, pollerFds);
+            subReactors = std::unique_ptr<ReactorPool>(new ReactorPool(
+                options.subReactorNum, threadPool, options.dispatchPolicy, options.ioBackend,
+                pollerFds));
+        } else {
+            reactor = std::make_shared<Reactor>(threadPool, options.ioBackend, pollerFds);
+        }
+    }
+    if (options.busyPollUs > 0) {
+        // 只有负责连接IO的Reactor忙轮询
+        if (subReactors) {
+            for (auto &loop : subReactors->getReactors()) {
+                loop->setBusyPoll(options.busyPollUs);
+            }
+        } else {
+            reactor->setBusyPoll(options.busyPollUs);
+        }
+        LOG_INFO("busy poll enabled, max spin %dus", options.busyPollUs)
+    }
+    LOG_INFO("using %s backend", reactor->getPollerName())
+    LOG_INFO("using %s request scanner", HttpRequest::Scanner())
+}
+
+void Server::stopLoops() {
+    if (reactor) {
+        reactor->quit();
+    }
+    if (subReactors) {
+        subReactors->stop();
+    }
+}
+
 void Server::start() {
-    if (!initSocket())
+    if (!initListeners()) {
+        fprintf(stderr, "invalid listen address\n");
+        return;
+    }
+    raiseFdLimit();
+    if (options.workerProcesses != 0) {
+        // 线程池与日志线程在fork之后由各worker自行创建
+        startMaster();
+        return;
+    }
+    initLog(".log");
+    initReactors();
+    startLoop();
+}
+
+void Server::raiseFdLimit() {
+    rlimit limit{};
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0) {
+        return;
+    }
+    auto want = static_cast<rlim_t>(options.maxConnections);
+    if (limit.rlim_cur < want) {
+        limit.rlim_cur = std::min(want, limit.rlim_max);
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+void Server::initSlabs() {
+    if (!options.numa) {
+        slabs_.emplace_back(new ConnSlab(options.maxConnections, options.connPrealloc));
+        return;
+    }
+    // 在绑定到各节点的线程中构造，预构造的槽及其缓冲区都分配在节点本地内存中
+    auto &topology = NumaTopology::get();
+    slabs_.resize(topology.nodeCount());
+    for (int node = 0; node < topology.nodeCount(); node++) {
+        std::thread([this, node, &topology] {
+            NumaTopology::bindThread(topology.cpus(node));
+            slabs_[node].reset(
+                new ConnSlab(options.maxConnections, options.connPrealloc, node));
+        }).join();
+    }
+}
+
+void Server::startLoop() {
+    // 连接槽在各进程中分别创建，避免预构造的槽在fork后被写时复制
+    initSlabs();
+    if (!initSocket()) {
         perror("Socket init failed.\n");
-    LOG_DEBUG("listenFd is [%d].", listenFd)
+        return;
+    }
 
     // 设置连接接收器
-    acceptor = std::make_shared<Channel>(listenFd);
-    acceptor->setEvents(listenEvent_ | EPOLLIN);
-    acceptor->setConnHandler([this] { handleAccept(); });
-    reactor->addToPoller(acceptor);
-
-    // 从STDIN读取quit命令
-    auto cmd = std::make_shared<Channel>(STDIN_FILENO);
-    cmd->setEvents(listenEvent_ | EPOLLIN);
-    cmd->setReadHandler([this] {
-        std::string buf;
-        std::cin >> buf;
-        if (buf == "quit") {
-            reactor->quit();
-        } else {
-            std::cout << "command error" << std::endl;
+    for (size_t i = 0; i < listeners_.size(); i++) {
+        auto &listener = listeners_[i];
+        LOG_INFO("listening on %s, fd [%d]", listener.addr.text.c_str(), listener.fd)
+        listener.channel = std::make_shared<Channel>(listener.fd);
+        listener.channel->setEvents(listenEvent_ | EPOLLIN);
+        listener.channel->setConnHandler([this, i] { handleAccept(i); });
+        reactor->addToPoller(listener.channel);
+    }
+
+    if (workerId_ < 0) {
+        // 从STDIN读取quit命令
+        auto cmd = std::make_shared<Channel>(STDIN_FILENO);
+        cmd->setEvents(listenEvent_ | EPOLLIN);
+        auto readCommand = [this] {
+            std::string buf;
+            if (!(std::cin >> buf)) {
+                return;
+            }
+            if (buf == "quit") {
+                reactor->quit();
+            } else if (buf == "stats") {
+                printStats();
+            } else if (buf == "conns") {
+                printConns();
+            } else {
+                std::cout << "command error" << std::endl;
+            }
+        };
+        cmd->setReadHandler(readCommand);
+        // 输入端关闭时（如管道写端退出）最后一条命令与挂断事件可能同时到达
+        cmd->setCloseHandler(readCommand);
+        reactor->addToPoller(cmd);
+    } else {
+        // worker进程由master通过SIGTERM通知退出
+        sigset_t mask;
+        sigemptyset(&mask);
+        sigaddset(&mask, SIGTERM);
+        sigaddset(&mask, SIGINT);
+        int sigFd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+        auto sig = std::make_shared<Channel>(sigFd);
+        sig->setEvents(EPOLLIN);
+        sig->setReadHandler([this, sigFd] {
+            signalfd_siginfo info{};
+            while (read(sigFd, &info, sizeof(info)) == sizeof(info)) {
+                LOG_INFO("worker %d received signal %d", workerId_, (int)info.ssi_signo)
+                reactor->quit();
+            }
+        });
+        reactor->addToPoller(sig);
+    }
+
+    if (subReactors) {
+        subReactors->start();
+    }
+
+    if (workerId_ >= 0 && options.cpuAffinity) {
+        // 只绑定IO线程，线程池中的线程在此之前已创建，不受影响
+        bindCpu(workerCpu_);
+    }
+
+    reactor->loop();
+}
+
+void Server::startMaster() {
+    int workerNum = options.workerProcesses;
+    if (workerNum < 0) {
+        workerNum = static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+    }
+    assert(workerNum > 0);
+
+    // 可用CPU列表，worker依次绑定
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &allowed)) {
+            cpus_.push_back(cpu);
         }
+    }
+    if (cpus_.empty()) {
+        cpus_.push_back(0);
+    }
+
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGINT);
+    sigprocmask(SIG_BLOCK, &mask, nullptr);
+    masterSigFd_ = signalfd(-1, &mask, SFD_CLOEXEC);
+    assert(masterSigFd_ > 0);
+
+    // Unix域套接字不支持SO_REUSEPORT，由master创建后各worker继承同一个监听套接字
+    for (auto &listener : listeners_) {
+        if (!listener.addr.isTcp() && (listener.fd = openListener(listener.addr)) < 0) {
+            perror("Socket init failed.\n");
+            return;
+        }
+    }
+
+    workers_.assign(workerNum, Worker{});
+    for (int i = 0; i < workerNum; i++) {
+        spawnWorker(i);
+    }
+    printf("master [%d] started %d workers\n", getpid(), workerNum);
+
+    pollfd fds[2] = {{masterSigFd_, POLLIN, 0}, {STDIN_FILENO, POLLIN, 0}};
+    bool stopping = false;
+    while (!stopping) {
+        if (::poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("master poll error");
+            break;
+        }
+        CoarseClock::update();
+        if (fds[1].revents & POLLIN) {
+            std::string buf;
+            if (!(std::cin >> buf)) {
+                fds[1].fd = -1; // STDIN已关闭，不再监听
+            } else if (buf == "quit") {
+                stopping = true;
+            } else {
+                std::cout << "command error" << std::endl;
+            }
+        } else if (fds[1].revents & (POLLHUP | POLLERR)) {
+            fds[1].fd = -1;
+        }
+        if (fds[0].revents & POLLIN) {
+            signalfd_siginfo info{};
+            auto n = read(masterSigFd_, &info, sizeof(info));
+            if (n == sizeof(info) && info.ssi_signo != SIGCHLD) {
+                stopping = true;
+            }
+        }
+        reapWorkers(!stopping);
+    }
+
+    for (auto &worker : workers_) {
+        if (worker.pid > 0) {
+            kill(worker.pid, SIGTERM);
+        }
+    }
+    for (auto &worker : workers_) {
+        if (worker.pid > 0) {
+            waitpid(worker.pid, nullptr, 0);
+            worker.pid = -1;
+        }
+    }
+    close(masterSigFd_);
+    printf("master [%d] quited\n", getpid());
+}
+
+void Server::spawnWorker(int id) {
+    auto &worker = workers_[id];
+    // 启动后立即退出的worker延迟重启，避免fork风暴
+    if (worker.spawnTime && time(nullptr) - worker.spawnTime < 1) {
+        sleep(1);
+    }
+    worker.spawnTime = time(nullptr);
+    fflush(stdout); // 避免子进程重复输出缓冲区内容
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork worker failed");
+        worker.pid = -1;
+        return;
+    }
+    if (pid > 0) {
+        worker.pid = pid;
+        return;
+    }
+
+    // worker进程
+    close(masterSigFd_);
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_UNBLOCK, &mask, nullptr);
+    workerId_ = id;
+    workerCpu_ = cpus_[id % cpus_.size()];
+    workers_.clear();
+
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), "-w%d.log", id);
+    initLog(suffix);
+    initReactors();
+    LOG_INFO("worker %d started on cpu %d", id, workerCpu_)
+    startLoop();
+    stopLoops();
+    LOG_INFO("worker %d quited", id)
+    exit(0);
+}
+
+void Server::reapWorkers(bool respawn) {
+    int status;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        for (size_t i = 0; i < workers_.size(); i++) {
+            if (workers_[i].pid != pid) {
+                continue;
+            }
+            workers_[i].pid = -1;
+            printf("worker %zu [%d] exited with status %d\n", i, pid, status);
+            if (respawn) {
+                spawnWorker(static_cast<int>(i));
+            }
+            break;
+        }
+    }
+}
+
+void Server::printStats() {
+    // NUMA模式下每个节点一个线程池，依次输出
+    std::vector<std::shared_ptr<ThreadPool>> threadPools;
+    std::vector<int> poolNodes;
+    for (auto &loop : subReactors ? subReactors->getReactors()
+                                  : std::vector<std::shared_ptr<Reactor>>{reactor}) {
+        auto threadPool = loop->getThreadPool();
+        if (threadPool
+            && std::find(threadPools.begin(), threadPools.end(), threadPool) == threadPools.end()) {
+            threadPools.push_back(threadPool);
+            poolNodes.push_back(loop->numaNode());
+        }
+    }
+    for (size_t i = 0; i < threadPools.size(); i++) {
+        auto &threadPool = threadPools[i];
+        if (poolNodes[i] >= 0) {
+            printf("node %d ", poolNodes[i]);
+        }
+        auto stats = threadPool->stats();
+        printf("thread pool: %d threads (%d-%d, %d created, %llu grows, %llu shrinks), "
+               "%zu queued, %llu executed, %llu stolen\n",
+               stats.active, threadPool->minSize(), threadPool->maxSize(), stats.spawned,
+               (unsigned long long)stats.grows, (unsigned long long)stats.shrinks, stats.queued,
+               (unsigned long long)stats.executed, (unsigned long long)stats.steals);
+        static const char *names[ThreadPool::PRIORITIES] = {"high", "normal", "low"};
+        for (int p = 0; p < ThreadPool::PRIORITIES; p++) {
+            auto &hist = stats.waitHist[p];
+            uint64_t total = 0;
+            for (auto n : hist) {
+                total += n;
+            }
+            // 按直方图桶的上限估计排队时间的分位数，落在最后一个桶时只给出下限
+            auto percentile = [&hist, total](double q) {
+                uint64_t seen = 0;
+                for (int b = 0; b < ThreadPool::WAIT_BUCKETS; b++) {
+                    seen += hist[b];
+                    if (total > 0 && seen >= total * q) {
+                        auto limit = ThreadPool::bucketLimitUs(b);
+                        return limit < 0 ? ">=" + std::to_string(ThreadPool::bucketLimitUs(b - 1))
+                                         : "<" + std::to_string(limit);
+                    }
+                }
+                return std::string("-");
+            };
+            printf("  %-6s lane: %zu queued, %llu run, wait p50 %sus, p99 %sus\n", names[p],
+                   stats.laneQueued[p], (unsigned long long)total, percentile(0.5).c_str(),
+                   percentile(0.99).c_str());
+        }
+    }
+    if (!threadPools.empty()) {
+        printf("fairness: %llu yields after %d requests\n", (unsigned long long)yieldCount_.load(),
+               options.maxRequestsPerTurn);
+    }
+    if (options.runToCompletion) {
+        printf("run to completion: %llu inline, %llu offloaded\n",
+               (unsigned long long)inlineCount_.load(), (unsigned long long)offloadCount_.load());
+    }
+    std::vector<std::shared_ptr<Reactor>> loops{reactor};
+    if (subReactors) {
+        loops = subReactors->getReactors();
+    }
+    if (options.busyPollUs > 0) {
+        Reactor::BusyPollStats total;
+        for (auto &loop : loops) {
+            auto stats = loop->busyPollStats();
+            total.hits += stats.hits;
+            total.misses += stats.misses;
+            total.spinUs += stats.spinUs;
+            total.budgetUs = std::max(total.budgetUs, stats.budgetUs);
+        }
+        printf("busy poll: %llu hits, %llu misses, %llu us spinning, budget %dus\n",
+               (unsigned long long)total.hits, (unsigned long long)total.misses,
+               (unsigned long long)total.spinUs, total.budgetUs);
+    }
+    printAcceptStats();
+    int timers = 0;
+    for (auto &loop : loops) {
+        timers += loop->getTimer()->size();
+    }
+    printf("connections: %d, timers: %d\n", conns_.liveCount(), timers);
+    // 每个连接的固定开销（连接槽、连接表项与定时器节点）加上缓冲区平均持有的内存
+    auto held = Buffer::HeldBytes();
+    auto fixed = ConnSlab::slotBytes() + ConnTable::entryBytes() + TimingWheel::nodeBytes();
+    int live = conns_.liveCount();
+    printf("memory: %zu KB in buffers, %zu bytes/connection (%zu fixed + %zu buffered), "
+           "%llu over read limit, %llu rejected over budget\n",
+           held / 1024, fixed + (live > 0 ? held / live : 0), fixed, live > 0 ? held / live : 0,
+           (unsigned long long)readLimitCount_.load(),
+           (unsigned long long)budgetRejectCount_.load());
+    printf("timeouts: %llu header, %llu body, %llu idle, %llu write\n",
+           (unsigned long long)timeoutCount_[HttpConn::HEADER_TIMEOUT].load(),
+           (unsigned long long)timeoutCount_[HttpConn::BODY_TIMEOUT].load(),
+           (unsigned long long)timeoutCount_[HttpConn::IDLE_TIMEOUT].load(),
+           (unsigned long long)timeoutCount_[HttpConn::WRITE_TIMEOUT].load());
+    // 大页arena按映射方式分别统计，没有预留大页或透明大页被禁用时全部为regular
+    auto printArena = [](const char *name, const HugePageArena::Stats &arena) {
+        printf("%s arena: %zu KB used", name, arena.used / 1024);
+        for (int i = 0; i < HugePageArena::BACKINGS; i++) {
+            printf(", %zu KB %s", arena.mapped[i] / 1024,
+                   HugePageArena::backingName(static_cast<HugePageArena::Backing>(i)));
+        }
+        printf("\n");
+    };
+    printArena("buffer", Buffer::ArenaStats());
+    auto cache = FileCache::get().stats();
+    printArena("file cache", cache.arena);
+    printf("file cache: %zu files, %zu changed, %zu KB, %llu hits, %llu misses\n", cache.files,
+           cache.changed, cache.bytes / 1024, (unsigned long long)cache.hits,
+           (unsigned long long)cache.misses);
+    AllocStats::print(stdout);
+    fflush(stdout);
+}
+
+void Server::printConns() {
+    if (slabs_.empty()) {
+        return;
+    }
+    std::vector<std::shared_ptr<Reactor>> loops{reactor};
+    if (subReactors) {
+        loops = subReactors->getReactors();
+    }
+    conns_.forEachLive([this, &loops](ConnTable::Handle handle, Reactor *loop) {
+        auto client = slabOf(handle.fd).conn(handle.fd);
+        auto peer = ListenAddr::format(client->GetAddr());
+        // 读取地址期间连接可能已关闭并被复用，再次确认代数
+        if (!conns_.alive(handle)) {
+            return;
+        }
+        int index = 0;
+        for (size_t i = 0; i < loops.size(); i++) {
+            if (loops[i].get() == loop) {
+                index = static_cast<int>(i);
+            }
+        }
+        printf("fd %d gen %u reactor %d node %d peer %s\n", handle.fd, handle.gen, index,
+               loop->numaNode(), peer.c_str());
     });
-    reactor->addToPoller(cmd);
-
-    // 设置定时器
-    int timerFd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
-    auto timer = std::make_shared<Channel>(timerFd);
-    timer->setEvents(EPOLLIN);
-    timer->setReadHandler([this, timer] {
-        char buf[8];
-        auto ret = read(timer->getFd(), buf, 8);
-        auto nextTick = heapTimer->getNextTick();
-        auto sec = nextTick / 1000;
-        auto nano_sec = (nextTick % 1000) * 1000000;
-        sec = std::max(sec, 1);
-        itimerspec new_value{timespec{1}, timespec{sec, nano_sec}};
-        timerfd_settime(timer->getFd(), 0, &new_value, nullptr);
-    });
-    itimerspec new_value{timespec{1}, timespec{1}};
-    timerfd_settime(timerFd, 0, &new_value, nullptr);
-    reactor->addToPoller(timer);
+    fflush(stdout);
+}
 
-    reactor->loop();
+bool Server::bindCpu(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        LOG_WARN("failed to bind worker %d to cpu %d", workerId_, cpu)
+        return false;
+    }
+    return true;
+}
+
+bool Server::initListeners() {
+    listeners_.clear();
+    if (options.listeners.empty()) {
+        if (port > 65535 || port < 1024) {
+            return false;
+        }
+        options.listeners.push_back(std::to_string(port));
+    }
+    for (auto &spec : options.listeners) {
+        Listener listener;
+        if (!ListenAddr::parse(spec, &listener.addr)) {
+            fprintf(stderr, "bad listen address: %s\n", spec.c_str());
+            return false;
+        }
+        listeners_.push_back(std::move(listener));
+    }
+    return true;
 }
 
 bool Server::initSocket() {
-    int ret;
-    sockaddr_in addr{};
-    if (port > 65535 || port < 1024) {
-        return false;
+    for (auto &listener : listeners_) {
+        if (listener.fd >= 0) {
+            continue; // 从master继承
+        }
+        listener.fd = openListener(listener.addr);
+        if (listener.fd < 0) {
+            fprintf(stderr, "listen on %s failed: %s\n", listener.addr.text.c_str(),
+                    strerror(errno));
+            return false;
+        }
     }
-    addr.sin_family = AF_INET;
-    addr.sin_addr.s_addr = htonl(INADDR_ANY);
-    addr.sin_port = htons(port);
+    lastStatsTime_ = std::chrono::steady_clock::now();
+    return true;
+}
+
+int Server::openListener(const ListenAddr &addr) {
+    int ret;
     struct linger optLinger = {0};
 
-    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    int listenFd = socket(addr.family(), SOCK_STREAM | SOCK_CLOEXEC, 0);
     if (listenFd < 0) {
-        return false;
+        return -1;
     }
 
     ret = setsockopt(listenFd, SOL_SOCKET, SO_LINGER, &optLinger, sizeof(optLinger));
     if (ret < 0) {
         close(listenFd);
-        return false;
+        return -1;
     }
 
     int optval = 1;
-    /* 端口复用 */
-    /* 只有最后一个套接字会正常接收数据。 */
-    ret = setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, (const void *)&optval, sizeof(int));
-    if (ret == -1) {
-        close(listenFd);
-        return false;
+    if (addr.isTcp()) {
+        /* 端口复用 */
+        /* 只有最后一个套接字会正常接收数据。 */
+        ret = setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, (const void *)&optval, sizeof(int));
+        if (ret == -1) {
+            close(listenFd);
+            return -1;
+        }
+    }
+
+    if (workerId_ >= 0 && addr.isTcp()) {
+        /* 每个worker持有独立的监听套接字，由内核在其间均衡分发连接 */
+        ret = setsockopt(listenFd, SOL_SOCKET, SO_REUSEPORT, (const void *)&optval, sizeof(int));
+        if (ret == -1) {
+            close(listenFd);
+            return -1;
+        }
+    }
+
+    if (addr.family() == AF_INET6) {
+        /* [::]同时接受IPv4连接，不受net.ipv6.bindv6only影响 */
+        int v6only = 0;
+        setsockopt(listenFd, IPPROTO_IPV6, IPV6_V6ONLY, &v6only, sizeof(v6only));
+    }
+
+    auto path = addr.path();
+    struct stat st {};
+    if (!path.empty() && stat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+        /* 上次退出时残留的套接字文件 */
+        unlink(path.c_str());
     }
 
-    ret = bind(listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+    ret = bind(listenFd, reinterpret_cast<const sockaddr *>(&addr.addr), addr.len);
     if (ret < 0) {
         close(listenFd);
-        return false;
+        return -1;
+    }
+
+    if (addr.isTcp() && options.deferAcceptSec > 0) {
+        /* 连接在收到首个数据包后才进入全连接队列 */
+        ret = setsockopt(listenFd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &options.deferAcceptSec,
+                         sizeof(int));
+        if (ret == -1) {
+            LOG_WARN("set TCP_DEFER_ACCEPT failed: %s", strerror(errno))
+        }
+    }
+    if (addr.isTcp() && options.fastOpenQueue > 0) {
+        ret = setsockopt(listenFd, IPPROTO_TCP, TCP_FASTOPEN, &options.fastOpenQueue, sizeof(int));
+        if (ret == -1) {
+            LOG_WARN("set TCP_FASTOPEN failed: %s", strerror(errno))
+        }
     }
 
-    ret = listen(listenFd, 6);
+    ret = listen(listenFd, options.listenBacklog);
     if (ret < 0) {
         close(listenFd);
-        return false;
+        return -1;
     }
     setFdNonblock(listenFd);
-    return true;
+    return listenFd;
 }
 
-void Server::handleAccept() {
-    sockaddr_in addr{};
-    socklen_t len = sizeof(addr);
-    do {
-        int fd = accept(listenFd, reinterpret_cast<sockaddr *>(&addr), &len);
-        if (fd <= 0)
+void Server::closeListeners() {
+    for (auto &listener : listeners_) {
+        if (listener.fd < 0) {
+            continue;
+        }
+        close(listener.fd);
+        listener.fd = -1;
+        // 套接字文件由创建它的进程（单进程或master）删除
+        auto path = listener.addr.path();
+        if (workerId_ < 0 && !path.empty()) {
+            unlink(path.c_str());
+        }
+    }
+}
+
+void Server::handleAccept(size_t index) {
+    auto &listener = listeners_[index];
+    bool tcp = listener.addr.isTcp();
+    sockaddr_storage addr{};
+    for (int i = 0; i < options.acceptBatch; i++) {
+        socklen_t len = sizeof(addr);
+        int fd = accept4(listener.fd, reinterpret_cast<sockaddr *>(&addr), &len,
+                         SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if (errno != EAGAIN) {
+                LOG_ERROR("accept error: %s", strerror(errno))
+            }
             return;
-        else if (HttpConn::userCount >= MAX_FD) {
+        } else if (fd >= options.maxConnections) {
+            rejectCount_.fetch_add(1, std::memory_order_relaxed);
             sendError(fd, "Server busy!");
-            return;
+            continue;
+        } else if (options.memoryBudget > 0 && Buffer::HeldBytes() >= options.memoryBudget) {
+            // 缓冲区内存已达上限，已有连接的请求优先
+            rejectCount_.fetch_add(1, std::memory_order_relaxed);
+            budgetRejectCount_.fetch_add(1, std::memory_order_relaxed);
+            sendError(fd, "Server busy!");
+            continue;
         }
         LOG_DEBUG("fd [%d] accepted", fd)
-        addClient(fd, addr);
-    } while (listenEvent_ & EPOLLET);
+        acceptCount_.fetch_add(1, std::memory_order_relaxed);
+        addClient(fd, addr, tcp);
+    }
+    // 边缘触发下队列中可能仍有连接，先处理本轮其他事件，再在本轮末尾继续接受
+    reactor->addPendingTask([this, index] { handleAccept(index); });
 }
 
-void Server::addClient(int fd, sockaddr_in addr) {
+void Server::addClient(int fd, const sockaddr_storage &addr, bool tcp) {
     assert(fd > 0);
-    clients[fd] = std::make_shared<HttpConn>();
-    clients[fd]->init(fd, addr);
-    auto channel = std::make_shared<Channel>(fd);
-    channel->setEvents(connEvent_ | EPOLLIN);
-    auto client = clients[fd];
-    assert(client);
-    assert(channel);
-    channel->setReadHandler([this, client] { handleRead(client); });
-    channel->setCloseHandler([this, client] {
-        LOG_DEBUG("closeHandler called on client[%d]", client->GetFd())
-        heapTimer->disable(client->GetFd());
-        closeConn(client);
-    });
-    reactor->addToPoller(channel);
-    heapTimer->add(fd, timeoutMS, [this, client] {
-        LOG_DEBUG("timeout callback() called on client[%d]", client->GetFd())
-        closeConn(client);
+    ALLOC_SCOPE(CONN);
+    auto loop = pickLoop(fd);
+    int node = std::max(loop->numaNode(), 0);
+    auto &slab = *slabs_[node];
+    bool firstUse;
+    auto &slot = slab.acquire(fd, &firstUse);
+    auto client = slab.conn(fd);
+    if (firstUse) {
+        // 槽在fd复用时重复使用，处理器只需设置一次
+        auto &channel = slot.channel;
+        channel.setReadHandler([this, client] { handleEvent(client, HttpConn::READABLE); });
+        channel.setWriteHandler([this, client] { handleEvent(client, HttpConn::WRITABLE); });
+        channel.setCloseHandler([this, client] {
+            LOG_DEBUG("closeHandler called on client[%d]", client->GetFd())
+            handleEvent(client, HttpConn::HANGUP);
+        });
+    }
+    client->init(fd, addr);
+    client->SetDeadline(HttpConn::HEADER_TIMEOUT,
+                        CoarseClock::monotonicMs() + deadlineMs_[HttpConn::HEADER_TIMEOUT]);
+    // 只注册一次读写边缘触发事件，处理器在连接生命周期内不再改变
+    slot.channel.setEvents(connEvent_);
+    auto handle = conns_.insert(fd, loop.get());
+    loop->incLoad();
+    if (tcp && options.socketBusyPollUs > 0) {
+        int value = options.socketBusyPollUs;
+        if (setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &value, sizeof(value)) < 0) {
+            LOG_WARN("set SO_BUSY_POLL on fd[%d] failed: %s", fd, strerror(errno))
+        }
+    }
+    // 注册及定时器操作均在连接所属的IO线程中完成
+    auto reactorPtr = loop.get();
+    reactorPtr->runInLoop([this, reactorPtr, handle, &slab] {
+        reactorPtr->addToPoller(slab.channel(handle.fd));
+        HttpConn::Deadline kind;
+        armTimer(reactorPtr, handle, slab.conn(handle.fd)->GetDeadline(&kind));
     });
-    setFdNonblock(fd);
 }
 
-void Server::handleRead(const std::shared_ptr<HttpConn> &client) {
-    assert(client);
-    heapTimer->adjust(client->GetFd(), timeoutMS);
-    LOG_DEBUG("handleRead() trying to append onRead() to thread pool on fd[%d]", client->GetFd())
-    reactor->appendToThreadPool([this, client] { onRead(client); });
-    LOG_DEBUG("handleRead() finished to append onRead() to thread pool on fd[%d]", client->GetFd())
+void Server::armTimer(Reactor *loop, ConnTable::Handle handle, int64_t at) {
+    auto client = slabOf(handle.fd).conn(handle.fd);
+    // 先写入定时器时间再读取到期时间，与updateDeadline中相反的顺序配对：
+    // 所有者提前的到期时间要么在这里读到，要么所有者读到新的定时器时间并通知重新设置
+    client->SetTimerAt(at);
+    HttpConn::Deadline kind;
+    auto deadline = client->GetDeadline(&kind);
+    if (deadline < at) {
+        at = deadline;
+        client->SetTimerAt(at);
+    }
+    auto delay = static_cast<int>(std::max<int64_t>(at - CoarseClock::monotonicMs(), 1));
+    loop->getTimer()->add(handle.fd, delay, [this, loop, handle] { onTimer(loop, handle); });
 }
 
-void Server::onRead(const std::shared_ptr<HttpConn> &client) {
-    assert(client);
-    int readErrno = 0;
-    auto ret = client->read(&readErrno);
-    if (ret <= 0 && readErrno != EAGAIN) {
-        LOG_DEBUG("onRead() called closeConn on client[%d]", client->GetFd())
-        heapTimer->disable(client->GetFd());
-        closeConn(client);
+void Server::onTimer(Reactor *loop, ConnTable::Handle handle) {
+    if (!conns_.alive(handle)) {
+        return;
+    }
+    auto client = slabOf(handle.fd).conn(handle.fd);
+    HttpConn::Deadline kind;
+    auto deadline = client->GetDeadline(&kind);
+    auto now = CoarseClock::monotonicMs();
+    if (deadline > now) {
+        // 到期时间在定时器设置后被推迟
+        armTimer(loop, handle, deadline);
+        return;
+    }
+    if (client->IsBusy()) {
+        // 正在处理中，处理结束时会更新到期时间
+        armTimer(loop, handle, now + BUSY_RETRY_MS);
         return;
     }
-    LOG_DEBUG("onRead() called onProcess on client[%d]", client->GetFd())
-    onProcess(client);
+    static const char *names[HttpConn::DEADLINES] = {"header", "body", "idle", "write"};
+    LOG_DEBUG("client[%d] %s timeout", handle.fd, names[kind])
+    timeoutCount_[kind].fetch_add(1, std::memory_order_relaxed);
+    handleEvent(client, HttpConn::HANGUP);
 }
 
-void Server::closeConn(const std::shared_ptr<HttpConn> &client) {
-    assert(client);
-    auto channel = reactor->getChannel(client->GetFd());
-    assert(channel);
-    reactor->removeFromPoller(channel);
-    client->Close();
+void Server::updateDeadline(const SP_HttpConn &client, uint32_t ev, size_t readBytes,
+                            size_t writeBytes) {
+    HttpConn::Deadline last;
+    client->GetDeadline(&last);
+    auto kind = client->CurrentDeadline();
+    // 请求头的时限从请求开始计算，期间的读取不推迟；请求体与发送在有进展时推迟；
+    // keep-alive连接在本轮读入并处理完请求后重新开始空闲计时
+    bool progressed = (kind == HttpConn::BODY_TIMEOUT && client->ToReadBytes() != readBytes)
+                      || (kind == HttpConn::WRITE_TIMEOUT
+                          && static_cast<size_t>(client->ToWriteBytes()) != writeBytes)
+                      || (kind == HttpConn::IDLE_TIMEOUT && (ev & HttpConn::READABLE));
+    if (kind != last || progressed) {
+        auto deadline = CoarseClock::monotonicMs() + deadlineMs_[kind];
+        client->SetDeadline(kind, deadline);
+        // 推迟的到期时间由定时器触发时重新设置，只有提前时需要通知所属IO线程
+        if (deadline < client->GetTimerAt()) {
+            auto loop = loopOf(client);
+            auto handle = conns_.handle(client->GetFd());
+            loop->runInLoop([this, loop, handle] { onTimer(loop, handle); });
+        }
+    }
 }
 
-void Server::onProcess(const std::shared_ptr<HttpConn> &client) {
-    assert(client);
-    if (client->process()) {
-        reactor->addPendingTask([this, client] { heapTimer->adjust(client->GetFd(), timeoutMS); });
-        reactor->appendToThreadPool([this, client] {
-            LOG_DEBUG("onWrite append from onProcess() called on client[%d]", client->GetFd())
-            onWrite(client);
-        });
-    } else {
-        auto channel = reactor->getChannel(client->GetFd());
-        channel->setReadHandler([this, client] { handleRead(client); });
-        channel->setEvents(connEvent_ | EPOLLIN);
-        reactor->updatePoller(channel);
-        LOG_DEBUG("onProcess() set handleRead() on client[%d]", client->GetFd())
+std::shared_ptr<Reactor> Server::pickLoop(int fd) {
+    if (!subReactors) {
+        return reactor;
+    }
+    if (options.numa) {
+        // 连接留在收到其数据包的CPU所在节点，协议栈已在该节点处理过的数据无需跨节点访问
+        int cpu = -1;
+        socklen_t len = sizeof(cpu);
+        if (getsockopt(fd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &len) == 0 && cpu >= 0) {
+            int node = NumaTopology::get().nodeOf(cpu);
+            if (node >= 0) {
+                return subReactors->getNext(node);
+            }
+        }
+    }
+    return subReactors->getNext();
+}
+
+ConnSlab &Server::slabOf(int fd) const {
+    auto loop = conns_.loop(fd);
+    assert(loop);
+    return *slabs_[std::max(loop->numaNode(), 0)];
+}
+
+Reactor *Server::loopOf(const SP_HttpConn &client) const {
+    auto loop = conns_.loop(client->GetFd());
+    assert(loop);
+    return loop;
+}
+
+// 本线程开始内联处理当前事件的时间，用于判断是否超出CPU预算
+static thread_local std::chrono::steady_clock::time_point inlineStart;
+
+bool Server::runInline(Reactor *loop, size_t bytes) {
+    if (!options.runToCompletion || !loop->isInLoopThread()) {
+        return false;
+    }
+    auto elapsed = std::chrono::steady_clock::now() - inlineStart;
+    if (bytes > options.inlineMaxBytes
+        || elapsed > std::chrono::microseconds(options.inlineBudgetUs)) {
+        offloadCount_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    inlineCount_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool Server::offload(Reactor *loop, const SP_HttpConn &client, size_t bytes) {
+    if (!loop->isInLoopThread() || !loop->getThreadPool() || runInline(loop, bytes)) {
+        return false;
+    }
+    // 所有权随任务一起转移到工作线程，待发送的数据优先完成
+    auto priority = client->ToWriteBytes() > 0 ? ThreadPool::HIGH : ThreadPool::NORMAL;
+    loop->appendToThreadPool([this, client] { onEvents(client, HttpConn::RESUME); }, priority);
+    return true;
+}
+
+void Server::yield(Reactor *loop, const SP_HttpConn &client) {
+    yieldCount_.fetch_add(1, std::memory_order_relaxed);
+    if (loop->isInLoopThread()) {
+        // 留到本轮其他连接的事件处理完后继续
+        loop->addPendingTask([this, client] { onEvents(client, HttpConn::RESUME); });
+        return;
     }
+    // 以最低优先级重新排队，先执行其他连接的任务
+    loop->appendToThreadPool([this, client] { onEvents(client, HttpConn::RESUME); },
+                             ThreadPool::LOW);
 }
 
-void Server::handleWrite(const std::shared_ptr<HttpConn> &client) {
+void Server::handleEvent(const SP_HttpConn &client, uint32_t ev) {
     assert(client);
-    heapTimer->adjust(client->GetFd(), timeoutMS);
-    LOG_DEBUG("handleWrite on client[%d] called,trying to append onWrite() to thread pool",
-              client->GetFd())
-    reactor->appendToThreadPool([this, client] {
-        LOG_DEBUG("onWrite append from handleWrite called on client[%d]", client->GetFd())
-        onWrite(client);
-    });
-    LOG_DEBUG("handleWrite on client[%d] finished to append onWrite() to thread pool",
-              client->GetFd())
+    auto loop = loopOf(client);
+    if (!loop->isInLoopThread()) {
+        // fd已被关闭并交给其他Reactor复用，来自原Reactor本轮的残留事件
+        return;
+    }
+    if (!client->MarkEvents(ev)) {
+        // 连接正由其他线程处理，事件已记录，由所有者在释放前处理
+        return;
+    }
+    if (options.runToCompletion || !loop->getThreadPool()) {
+        // 在IO线程中直接读取、解析并发送，仅在可能阻塞或超出预算时交给线程池
+        inlineStart = std::chrono::steady_clock::now();
+        onEvents(client, 0);
+        return;
+    }
+    // 完成写出的任务优先，其次是已读入待解析的请求，新的读取最后
+    auto priority = ThreadPool::LOW;
+    if ((ev & HttpConn::WRITABLE) && client->ToWriteBytes() > 0) {
+        priority = ThreadPool::HIGH;
+    } else if (client->ToReadBytes() > 0) {
+        priority = ThreadPool::NORMAL;
+    }
+    loop->appendToThreadPool([this, client] { onEvents(client, 0); }, priority);
 }
 
-void Server::onWrite(const std::shared_ptr<HttpConn> &client) {
+void Server::onEvents(const SP_HttpConn &client, uint32_t carried) {
     assert(client);
-    int writeErrno = 0;
-    auto ret = client->write(&writeErrno);
-    if (client->ToWriteBytes() == 0) {
-        if (client->IsKeepAlive()) {
-            onProcess(client);
+    do {
+        auto ev = client->TakeEvents() | carried;
+        carried = 0;
+        size_t readBytes = client->ToReadBytes();
+        size_t writeBytes = client->ToWriteBytes();
+        if (ev & HttpConn::HANGUP) {
+            closeConn(client);
+            return;
+        }
+        if ((ev & HttpConn::READABLE) && !onRead(client)) {
             return;
         }
-    } else if (ret < 0) {
-        if (writeErrno == EAGAIN) {
-            auto channel = reactor->getChannel(client->GetFd());
-            channel->setEvents(connEvent_ | EPOLLOUT);
-            channel->setWriteHandler([this, client] {
-                LOG_DEBUG("onWrite set WriteHandler on client[%d]", client->GetFd())
-                handleWrite(client);
-            });
-            reactor->updatePoller(channel);
+        // 解析只在有新数据或继续处理时进行，单纯的可写事件只用于发送剩余数据
+        if ((ev & (HttpConn::READABLE | HttpConn::RESUME) || client->ToWriteBytes() > 0)
+            && !onProcess(client)) {
             return;
         }
+        if (client->ReadPaused()) {
+            if (client->ToReadBytes() >= options.connReadLimit) {
+                // 读缓冲区已满仍不能组成完整的请求
+                LOG_WARN("client[%d] request exceeds %zu bytes", client->GetFd(),
+                         options.connReadLimit)
+                readLimitCount_.fetch_add(1, std::memory_order_relaxed);
+                closeConn(client);
+                return;
+            }
+            // 已读入的请求处理完毕，继续读取暂停时未读的数据
+            carried = HttpConn::READABLE;
+        }
+        updateDeadline(client, ev, readBytes, writeBytes);
+    } while (carried || !client->Release());
+}
+
+bool Server::onRead(const SP_HttpConn &client) {
+    int readErrno = 0;
+    auto ret = client->read(&readErrno, options.connReadLimit);
+    if (ret <= 0 && readErrno != EAGAIN) {
+        LOG_DEBUG("onRead() called closeConn on client[%d]", client->GetFd())
+        closeConn(client);
+        return false;
+    }
+    return true;
+}
+
+bool Server::onProcess(const SP_HttpConn &client) {
+    auto loop = loopOf(client);
+    int served = 0;
+    while (true) {
+        if (client->ToWriteBytes() == 0) {
+            // 请求体较大，解析交给线程池
+            if (offload(loop, client, client->ToReadBytes())) {
+                return false;
+            }
+            if (!client->process()) {
+                return true;
+            }
+        }
+        if (offload(loop, client, client->ToWriteBytes())) {
+            return false;
+        }
+        int writeErrno = 0;
+        auto ret = client->write(&writeErrno);
+        if (client->ToWriteBytes() > 0) {
+            if (ret < 0 && writeErrno == EAGAIN) {
+                // 等待下一次EPOLLOUT边缘继续发送
+                return true;
+            }
+            break;
+        }
+        if (!client->IsKeepAlive()) {
+            break;
+        }
+        if (++served >= options.maxRequestsPerTurn && client->ToReadBytes() > 0) {
+            // 流水线中还有请求，让出给其他连接
+            yield(loop, client);
+            return false;
+        }
     }
-    LOG_DEBUG("onWrite() called closeConn on client[%d]", client->GetFd())
-    heapTimer->disable(client->GetFd());
+    LOG_DEBUG("onProcess() called closeConn on client[%d]", client->GetFd())
     closeConn(client);
+    return false;
+}
+
+void Server::closeConn(const SP_HttpConn &client) {
+    assert(client);
+    auto loop = loopOf(client);
+    // 注销与关闭必须在IO线程中完成，避免与fd复用产生竞争；
+    // 连接的所有权不再释放，关闭前到达的事件均被忽略
+    loop->runInLoop([this, loop, client] {
+        if (client->IsClosed()) {
+            return;
+        }
+        loop->getTimer()->disable(client->GetFd());
+        loop->removeFromPoller(slabOf(client->GetFd()).channel(client->GetFd()));
+        loop->decLoad();
+        // 先注销表项再关闭fd，fd一旦关闭就可能被接受线程复用
+        conns_.remove(client->GetFd());
+        client->Close();
+    });
+}
+
+// 读取/proc/net/netstat中TcpExt的指定计数，该计数为整个网络命名空间的累计值
+static long long readTcpExt(const char *name) {
+    FILE *fp = fopen("/proc/net/netstat", "r");
+    if (!fp) {
+        return -1;
+    }
+    char keys[4096], values[4096];
+    long long ret = -1;
+    while (ret < 0 && fgets(keys, sizeof(keys), fp) && fgets(values, sizeof(values), fp)) {
+        if (strncmp(keys, "TcpExt:", 7) != 0) {
+            continue;
+        }
+        char *keySave = nullptr, *valueSave = nullptr;
+        char *key = strtok_r(keys, " \n", &keySave);
+        char *value = strtok_r(values, " \n", &valueSave);
+        while (key && value) {
+            if (strcmp(key, name) == 0) {
+                ret = atoll(value);
+                break;
+            }
+            key = strtok_r(nullptr, " \n", &keySave);
+            value = strtok_r(nullptr, " \n", &valueSave);
+        }
+    }
+    fclose(fp);
+    return ret;
+}
+
+void Server::printAcceptStats() {
+    auto now = std::chrono::steady_clock::now();
+    auto accepted = acceptCount_.load(std::memory_order_relaxed);
+    auto seconds = std::chrono::duration<double>(now - lastStatsTime_).count();
+    double rate = seconds > 0 ? (accepted - lastAcceptCount_) / seconds : 0;
+    lastAcceptCount_ = accepted;
+    lastStatsTime_ = now;
+    printf("accept: %llu accepted, %llu rejected, %.1f/s since last stats\n",
+           (unsigned long long)accepted,
+           (unsigned long long)rejectCount_.load(std::memory_order_relaxed), rate);
+    // 监听套接字的tcpi_unacked为当前全连接队列长度，tcpi_sacked为队列上限
+    for (auto &listener : listeners_) {
+        tcp_info info{};
+        socklen_t len = sizeof(info);
+        if (listener.addr.isTcp()
+            && getsockopt(listener.fd, IPPROTO_TCP, TCP_INFO, &info, &len) == 0) {
+            printf("listen queue %s: %u/%u\n", listener.addr.text.c_str(), info.tcpi_unacked,
+                   info.tcpi_sacked);
+        }
+    }
+    printf("listen overflows: %lld, drops: %lld\n", readTcpExt("ListenOverflows"),
+           readTcpExt("ListenDrops"));
 }
 
 int Server::setFdNonblock(int fd) {
     assert(fd > 0);
-    return fcntl(fd, F_SETFL, fcntl(fd, F_GETFD, 0) | O_NONBLOCK);
+    return fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
 }
 
 void Server::sendError(int fd, const char *info) {
@@ -2,51 +2,234 @@
 
 #include <netinet/in.h>
 #include <sys/timerfd.h>
+#include <sys/types.h>
+#include <ctime>
+#include <chrono>
 
 #include "../net/Reactor.hpp"
-#include "../base/HeapTimer.hpp"
-
-class HttpConn;
+#include "../net/ReactorPool.hpp"
+#include "../base/Numa.hpp"
+#include "ConnSlab.hpp"
+#include "ConnTable.hpp"
+#include "ListenAddr.hpp"
+
+
+struct ServerOptions {
+    int port = 1316;
+    // 监听地址列表，格式见ListenAddr；为空时监听所有IPv4地址的port端口
+    std::vector<std::string> listeners;
+    // 线程池的最大线程数，为0时不使用线程池，小于0时按可用CPU数确定
+    int threadNum = -1;
+    // 线程池的最小线程数，小于0时按可用CPU数确定
+    int minThreads = -1;
+    // 线程池任务平均排队时间超过该值（微秒）且线程忙碌时扩容
+    int poolTargetWaitUs = 500;
+    // 线程池利用率持续偏低超过该时长（毫秒）后缩容
+    int poolIdleMs = 2000;
+    // keep-alive连接两次请求之间的空闲超时
+    int timeoutMS = 60000; /* 毫秒MS */
+    // 从连接建立或请求的首个字节到收到完整请求头的时限，期间的读取不会推迟到期时间
+    int headerTimeoutMs = 10000;
+    // 接收请求体时两次读取之间的最长间隔
+    int bodyTimeoutMs = 30000;
+    // 发送响应时两次写出进展之间的最长间隔
+    int writeTimeoutMs = 30000;
+    bool openLog = false;
+    int logLevel = 1;
+
+    // 子Reactor数量，为0时使用单Reactor + 线程池模型
+    int subReactorNum = 0;
+    // 新连接分发到子Reactor的策略
+    ReactorPool::Policy dispatchPolicy = ReactorPool::ROUND_ROBIN;
+
+    // 在IO线程中直接完成读取、解析与发送，仅在可能阻塞或超出预算时交给线程池
+    bool runToCompletion = false;
+    // 内联处理的请求或响应大小上限，超出时（如大文件、大请求体）交给线程池
+    size_t inlineMaxBytes = 64 * 1024;
+    // 单个事件内联处理的CPU时间预算（微秒）
+    int inlineBudgetUs = 500;
+
+    // 线程池各优先级（完成写出、处理已读入的请求、读取新数据）每轮调度的权重
+    ThreadPool::Weights laneWeights{{4, 2, 1}};
+    // 同一连接一次连续处理的请求数上限，达到后让出，避免流水线请求多的连接长期占用线程
+    int maxRequestsPerTurn = 16;
+
+    // 启动时预先构造的连接槽数
+    int connPrealloc = 1024;
+    // 最大连接数（连接槽、连接表与定时器按fd编号容纳的上限），启动时按此提高RLIMIT_NOFILE
+    int maxConnections = 65536;
+    // 单个连接读缓冲区的上限（字节），达到时暂停读取，处理已读入的请求后仍达到上限时关闭连接
+    size_t connReadLimit = 1 << 20;
+    // 所有缓冲区的内存上限（字节），超出时拒绝新连接，为0时不限制
+    size_t memoryBudget = 0;
+
+    // 监听队列长度，实际值受net.core.somaxconn限制
+    int listenBacklog = SOMAXCONN;
+    // 每次监听套接字就绪时最多接受的连接数，剩余连接在本轮事件处理完后继续接受
+    int acceptBatch = 64;
+    // TCP_DEFER_ACCEPT超时（秒），为0时不设置；开启后连接在收到数据时才会被接受
+    int deferAcceptSec = 0;
+    // TCP_FASTOPEN队列长度，为0时不开启
+    int fastOpenQueue = 0;
+
+    // IO线程阻塞等待前忙轮询的时间上限（微秒），为0时不忙轮询；实际时长按事件到达间隔自适应
+    int busyPollUs = 0;
+    // 已接受连接的SO_BUSY_POLL值（微秒），为0时不设置；超过net.core.busy_read时需要CAP_NET_ADMIN
+    int socketBusyPollUs = 0;
+
+    // 按NUMA节点放置：每个节点的子Reactor与线程池绑定到该节点的CPU，连接槽从节点本地内存分配，
+    // 新连接交给收到其数据包的CPU所在节点处理；多进程模式下不生效
+    bool numa = false;
+
+    // IO多路复用后端，io_uring不可用时自动回退到epoll
+    Poller::Backend ioBackend = Poller::EPOLL;
+
+    // worker进程数，为0时单进程运行，小于0时每个CPU一个worker
+    int workerProcesses = 0;
+    // 是否将各worker的IO线程绑定到不同CPU
+    bool cpuAffinity = true;
+};
 
 class Server {
+    ServerOptions options;
     char *srcDir;
     int port;
     bool isClosed = false;
-    int listenFd{};
     int timeoutMS; /* 毫秒MS */
-
-    static const int MAX_FD = 65536;
+    // 各超时类别的时长，以HttpConn::Deadline为下标
+    int deadlineMs_[HttpConn::DEADLINES];
+    // 到期时连接正在处理中，稍后再检查；处理结束时的到期时间更新会提前唤醒定时器
+    static const int BUSY_RETRY_MS = 100;
 
     uint32_t listenEvent_;
     uint32_t connEvent_;
 
-    std::unordered_map<int, std::shared_ptr<HttpConn>> clients;
+    // 以fd为下标的连接对象槽，连接对象在fd复用时重置使用；NUMA模式下每个节点一个
+    std::vector<std::unique_ptr<ConnSlab>> slabs_;
 
+    // 主Reactor，负责接受连接；单Reactor模式下同时负责所有连接的IO
     std::shared_ptr<Reactor> reactor;
 
-    std::shared_ptr<Channel> acceptor;
-
-    std::unique_ptr<HeapTimer> heapTimer;
+    // 子Reactor池，多Reactor模式下负责已接受连接的IO
+    std::unique_ptr<ReactorPool> subReactors;
+
+    // 以fd为下标的存活连接表，记录连接的代数及所属的Reactor
+    ConnTable conns_;
+
+    struct Listener {
+        ListenAddr addr;
+        int fd = -1;
+        std::shared_ptr<Channel> channel;
+    };
+
+    // 所有监听套接字共用同一个主Reactor及handleAccept
+    std::vector<Listener> listeners_;
+
+    struct Worker {
+        pid_t pid = -1;
+        time_t spawnTime = 0;
+    };
+
+    // 以下为多进程模式使用，workerId_小于0表示当前为单进程或master进程
+    int workerId_ = -1;
+    int workerCpu_ = -1;
+    int masterSigFd_ = -1;
+    std::vector<int> cpus_;
+    std::vector<Worker> workers_;
+
+    // 已接受的连接数及因连接数已满而拒绝的连接数
+    std::atomic<uint64_t> acceptCount_{0};
+    std::atomic<uint64_t> rejectCount_{0};
+    // 上一次输出统计信息时的接受数与时间，用于计算接受速率
+    uint64_t lastAcceptCount_ = 0;
+    std::chrono::steady_clock::time_point lastStatsTime_;
+
+    // 内联完成与交给线程池处理的次数
+    std::atomic<uint64_t> inlineCount_{0};
+    std::atomic<uint64_t> offloadCount_{0};
+    // 因达到maxRequestsPerTurn而让出的次数
+    std::atomic<uint64_t> yieldCount_{0};
+    // 各类超时关闭的连接数
+    std::atomic<uint64_t> timeoutCount_[HttpConn::DEADLINES] = {};
+    // 请求超出读缓冲区上限而关闭的连接数，超出内存上限而拒绝的连接数
+    std::atomic<uint64_t> readLimitCount_{0};
+    std::atomic<uint64_t> budgetRejectCount_{0};
 
     static void sendError(int fd, const char *info);
 
     static int setFdNonblock(int fd);
-    void addClient(int fd, sockaddr_in addr);
-
-    void handleAccept();
-    void handleRead(const std::shared_ptr<HttpConn> &client);
-    void handleWrite(const std::shared_ptr<HttpConn> &client);
 
-    void onRead(const std::shared_ptr<HttpConn> &client);
-    void onWrite(const std::shared_ptr<HttpConn> &client);
-    void onProcess(const std::shared_ptr<HttpConn> &client);
-    void closeConn(const std::shared_ptr<HttpConn> &client);
+    void initLog(const char *suffix);
+    // 按最大连接数提高打开文件数的软限制
+    void raiseFdLimit();
+    // 解析监听地址列表
+    bool initListeners();
+    // 创建、绑定并监听单个地址，失败时返回-1
+    int openListener(const ListenAddr &addr);
+    void closeListeners();
+    void initReactors();
+    // cpus为线程池可使用的CPU数，按此确定默认的线程数上下限
+    ThreadPool::Options poolOptions(int cpus) const;
+    void initSlabs();
+    void stopLoops();
+    void startLoop();
+
+    void startMaster();
+    void spawnWorker(int id);
+    void reapWorkers(bool respawn);
+    bool bindCpu(int cpu);
+
+    // 输出运行时统计信息，由STDIN的stats命令触发
+    void printStats();
+    void printAcceptStats();
+    // 列出当前存活的连接，由STDIN的conns命令触发
+    void printConns();
+
+    void addClient(int fd, const sockaddr_storage &addr, bool tcp);
+
+    Reactor *loopOf(const SP_HttpConn &client) const;
+
+    // fd所属Reactor所在节点的连接槽，只能在fd登记到conns_之后调用
+    ConnSlab &slabOf(int fd) const;
+
+    // 按收到连接数据包的CPU选取同一节点的Reactor
+    std::shared_ptr<Reactor> pickLoop(int fd);
+
+    // 判断当前任务能否在IO线程中内联完成
+    bool runInline(Reactor *loop, size_t bytes);
+
+    // 在IO线程中不宜继续内联处理时，将连接连同所有权交给线程池
+    bool offload(Reactor *loop, const SP_HttpConn &client, size_t bytes);
+
+    // 连接连续处理的请求数达到上限时，连同所有权重新排队，排在其他连接之后继续处理
+    void yield(Reactor *loop, const SP_HttpConn &client);
+
+    void handleAccept(size_t index);
+    // IO线程中的事件入口，获得连接所有权后分发处理
+    void handleEvent(const SP_HttpConn &client, uint32_t ev);
+
+    // 以下函数只由连接的所有者调用，返回false表示连接已关闭或已交给线程池
+    void onEvents(const SP_HttpConn &client, uint32_t carried);
+    bool onRead(const SP_HttpConn &client);
+    bool onProcess(const SP_HttpConn &client);
+    void closeConn(const SP_HttpConn &client);
+
+    // 超时类别或进展发生变化时由所有者更新到期时间，ev为本轮处理的事件，
+    // readBytes与writeBytes为本轮处理前的缓冲区数据量；到期时间早于定时器时通知所属IO线程重新设置
+    void updateDeadline(const SP_HttpConn &client, uint32_t ev, size_t readBytes,
+                        size_t writeBytes);
+    // 以下两个函数只在连接所属的IO线程中调用
+    // 将定时器设置在时刻at（毫秒），连接的到期时间更早时以到期时间为准
+    void armTimer(Reactor *loop, ConnTable::Handle handle, int64_t at);
+    // 定时器到期时按连接当前的到期时间关闭连接或重新设置定时器
+    void onTimer(Reactor *loop, ConnTable::Handle handle);
 
 public:
     Server(int _port, int _threadNum, int _timeoutMS = 60000, bool openLog = false,
            int logLevel = 1);
+    explicit Server(const ServerOptions &_options);
     ~Server();
 
     bool initSocket();
     void start();
-};
\ No newline at end of file
+};
@@ -0,0 +1,157 @@
+// keep-alive请求经过HttpConn的读取、解析、生成响应与发送，预热后不应再有堆分配；
+// 包括超过一个缓冲区块的请求头、跨越块边界的流水线请求与带请求体的请求
+// 以WS_ALLOC_STATS编译，通过socketpair驱动，不需要监听端口
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "../base/AllocStats.hpp"
+#include "../http/HttpConn.hpp"
+
+#define CHECK(cond)                                                                  \
+    do {                                                                             \
+        if (!(cond)) {                                                               \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            exit(1);                                                                 \
+        }                                                                            \
+    } while (0)
+
+namespace {
+
+const int WARMUP = 4;
+const int ROUNDS = 64;
+
+// 在临时目录中准备资源文件，返回以'/'结尾的目录
+std::string makeResources() {
+    static char dir[] = "/tmp/ws_alloc_test_XXXXXX";
+    CHECK(mkdtemp(dir));
+    std::string path = std::string(dir) + "/index.html";
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    CHECK(fd >= 0);
+    const char body[] = "<html><body>hello</body></html>";
+    CHECK(write(fd, body, sizeof(body) - 1) == static_cast<ssize_t>(sizeof(body) - 1));
+    close(fd);
+    return std::string(dir) + "/";
+}
+
+const char REQUEST[] =
+    "GET /index.html HTTP/1.1\r\nHost: localhost\r\nConnection: keep-alive\r\n\r\n";
+
+// 请求都在测量之前构造好，测量期间测试本身也不分配
+struct Requests {
+    std::string simple = REQUEST;
+    // 请求头超过一个标准块（4KB），解析时需要合并
+    std::string largeHeader;
+    // 一次到达的多个请求，读入后跨越块的边界
+    std::string pipeline;
+    std::string body;
+};
+
+const int PIPELINE = 64;
+
+Requests makeRequests() {
+    Requests requests;
+    requests.largeHeader = "GET /index.html HTTP/1.1\r\nHost: localhost\r\n";
+    for (int i = 0; i < 4; i++) {
+        requests.largeHeader += "X-Pad-" + std::to_string(i) + ": " + std::string(2000, 'p') + "\r\n";
+    }
+    requests.largeHeader += "Connection: keep-alive\r\n\r\n";
+    for (int i = 0; i < PIPELINE; i++) {
+        requests.pipeline += REQUEST;
+    }
+    CHECK(requests.pipeline.size() > 4096);
+    std::string content(3000, 'c');
+    requests.body = "POST /index.html HTTP/1.1\r\nHost: localhost\r\nConnection: keep-alive\r\n"
+                    "Content-Length: "
+                    + std::to_string(content.size()) + "\r\n\r\n" + content;
+    return requests;
+}
+
+// 发送data中的count个keep-alive请求，由HttpConn处理并发送响应，客户端读完全部响应
+void roundTrip(HttpConn &conn, int client, const std::string &data, int count, char *resp,
+               size_t cap) {
+    CHECK(write(client, data.data(), data.size()) == static_cast<ssize_t>(data.size()));
+
+    int err = 0;
+    CHECK(conn.read(&err) > 0 || err == EAGAIN);
+    for (int i = 0; i < count; i++) {
+        CHECK(conn.process());
+        CHECK(conn.write(&err) >= 0 || err == EAGAIN);
+        CHECK(conn.ToWriteBytes() == 0);
+    }
+    // 请求处理完后的空闲处理：释放缓冲区与请求数据
+    CHECK(!conn.process());
+
+    size_t total = 0;
+    ssize_t n;
+    while (total < cap - 1 && (n = read(client, resp + total, cap - 1 - total)) > 0) {
+        total += n;
+    }
+    CHECK(total > 0 && total < cap - 1);
+    resp[total] = '\0';
+    int responses = 0;
+    for (const char *p = resp; (p = strstr(p, "HTTP/1.1 200 OK\r\n")) != nullptr; p++) {
+        responses++;
+    }
+    CHECK(responses == count);
+    CHECK(strncmp(resp, "HTTP/1.1 200 OK\r\n", 17) == 0);
+    CHECK(strstr(resp, "hello") != nullptr);
+}
+
+// 依次发送各种请求
+void roundTrips(HttpConn &conn, int client, const Requests &requests, char *resp, size_t cap) {
+    roundTrip(conn, client, requests.simple, 1, resp, cap);
+    roundTrip(conn, client, requests.largeHeader, 1, resp, cap);
+    roundTrip(conn, client, requests.pipeline, PIPELINE, resp, cap);
+    roundTrip(conn, client, requests.body, 1, resp, cap);
+}
+
+} // namespace
+
+int main() {
+    if (!AllocStats::enabled()) {
+        fprintf(stderr, "built without WS_ALLOC_STATS\n");
+        return 1;
+    }
+    std::string dir = makeResources();
+    HttpConn::srcDir = dir.c_str();
+    HttpConn::isET = true;
+
+    int fds[2];
+    CHECK(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds) == 0);
+    sockaddr_storage addr = {};
+    addr.ss_family = AF_UNIX;
+
+    HttpConn conn;
+    conn.init(fds[0], addr);
+    Requests requests = makeRequests();
+    static char resp[65536];
+
+    // 预热：文件首次读入缓存、缓冲区的块首次取得
+    for (int i = 0; i < WARMUP; i++) {
+        roundTrips(conn, fds[1], requests, resp, sizeof(resp));
+    }
+    auto before = AllocStats::threadCount();
+    auto violations = AllocStats::violations();
+    for (int i = 0; i < ROUNDS; i++) {
+        roundTrips(conn, fds[1], requests, resp, sizeof(resp));
+    }
+    auto allocs = AllocStats::threadCount() - before;
+    printf("%d rounds of keep-alive requests: %llu allocations\n", ROUNDS,
+           (unsigned long long)allocs);
+    CHECK(allocs == 0);
+    CHECK(AllocStats::violations() == violations);
+
+    conn.Close();
+    close(fds[1]);
+    unlink((dir + "index.html").c_str());
+    rmdir(dir.c_str());
+    return 0;
+}
@@ -0,0 +1,289 @@
+// HttpRequest增量解析器：各扫描实现的结果一致，请求在任意位置被分开读入或跨越缓冲区的块时
+// 解析结果不变，长度与数量的上限、不接受的请求格式以及流水线请求
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+
+#include "../http/HttpRequest.hpp"
+
+#define CHECK(cond)                                                                  \
+    do {                                                                             \
+        if (!(cond)) {                                                               \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            exit(1);                                                                 \
+        }                                                                            \
+    } while (0)
+
+namespace {
+
+std::string str(StrView view) {
+    return std::string(view.data, view.len);
+}
+
+// 一个块能放下的字节数
+size_t chunkCapacity() {
+    Buffer buff;
+    buff.EnsureWriteable(1);
+    return buff.WritableBytes();
+}
+
+// 向空的buff写入data（不能为空），使其从距块末尾offset字节处开始，之后的数据跨越块的边界；
+// offset为0时从新块的开头开始
+void appendAt(Buffer &buff, size_t offset, const std::string &data) {
+    size_t filler = chunkCapacity() - offset;
+    buff.Append(std::string(filler, 'x'));
+    buff.Append(data);
+    buff.Retrieve(filler);
+    CHECK(offset == 0 || buff.ContiguousBytes() == std::min(offset, data.size()));
+}
+
+// 完整解析data中的一个请求，返回httpCode
+int parseAll(const std::string &data, HttpRequest &request) {
+    Buffer buff;
+    buff.Append(data);
+    request.Init();
+    request.parse(buff);
+    return request.httpCode;
+}
+
+void testScanners() {
+    auto scalar = HttpRequest::ScannerImpl("scalar");
+    CHECK(scalar);
+    CHECK(!HttpRequest::ScannerImpl("unknown"));
+    const char *names[] = {"avx2", "sse4.2"};
+    std::mt19937 rng(1);
+    for (auto name : names) {
+        auto impl = HttpRequest::ScannerImpl(name);
+        if (!impl) {
+            printf("%s: not supported\n", name);
+            continue;
+        }
+        char data[160];
+        // 长度覆盖一个完整的向量之后剩余0到31字节的各种情况，控制字符出现在各个位置或不出现
+        for (size_t len = 0; len <= 128; len++) {
+            for (int round = 0; round < 64; round++) {
+                for (size_t i = 0; i < len; i++) {
+                    data[i] = static_cast<char>(' ' + rng() % 95);
+                }
+                if (round % 8 != 0 && len > 0) {
+                    const char controls[] = {'\r', '\n', '\0', '\x1f', '\x7f', '\x01'};
+                    data[rng() % len] = controls[rng() % sizeof(controls)];
+                }
+                if (round % 4 == 1 && len > 0) {
+                    // HT不是控制字符，高位字节也不是
+                    data[rng() % len] = '\t';
+                    data[rng() % len] = static_cast<char>(0x80 + rng() % 128);
+                }
+                CHECK(impl(data, data + len) == scalar(data, data + len));
+            }
+        }
+        printf("%s: agrees with scalar\n", name);
+    }
+    CHECK(HttpRequest::ScannerImpl(HttpRequest::Scanner()));
+}
+
+const char REQUEST[] =
+    "GET /picture HTTP/1.1\r\n"
+    "Host: localhost\r\n"
+    "User-Agent: test\r\n"
+    "Accept: */*\r\n"
+    "Connection: keep-alive\r\n"
+    "\r\n";
+
+void checkRequest(const HttpRequest &request) {
+    CHECK(request.httpCode == HttpRequest::GET_REQUEST);
+    CHECK(str(request.method()) == "GET");
+    CHECK(str(request.path()) == "/picture.html");
+    CHECK(str(request.version()) == "1.1");
+    CHECK(str(request.header("host")) == "localhost");
+    CHECK(str(request.header("User-Agent")) == "test");
+    CHECK(request.IsKeepAlive());
+    CHECK(request.Length() == sizeof(REQUEST) - 1);
+}
+
+// 请求在每个字节处被分为两次读入，同时在每个位置跨越块的边界
+void testSplits() {
+    const std::string request = REQUEST;
+    for (size_t split = 0; split <= request.size(); split++) {
+        Buffer buff;
+        HttpRequest parser;
+        buff.Append(request.data(), split);
+        if (split < request.size()) {
+            CHECK(!parser.parse(buff));
+            CHECK(parser.httpCode == HttpRequest::NO_REQUEST);
+        }
+        buff.Append(request.data() + split, request.size() - split);
+        CHECK(parser.parse(buff));
+        checkRequest(parser);
+    }
+    for (size_t offset = 0; offset <= request.size(); offset++) {
+        for (size_t split : {size_t(1), offset / 2 + 1, offset + 1, request.size()}) {
+            split = std::min(split, request.size());
+            Buffer buff;
+            HttpRequest parser;
+            appendAt(buff, offset, request.substr(0, split));
+            if (split < request.size()) {
+                CHECK(!parser.parse(buff));
+                CHECK(parser.httpCode == HttpRequest::NO_REQUEST);
+            }
+            buff.Append(request.data() + split, request.size() - split);
+            CHECK(parser.parse(buff));
+            checkRequest(parser);
+        }
+    }
+}
+
+void testLimits() {
+    HttpRequest request;
+    // 请求行与请求头行的长度上限（不含行尾）
+    std::string prefix = "GET /";
+    std::string suffix = " HTTP/1.1";
+    std::string target(HttpRequest::MAX_LINE - prefix.size() - suffix.size(), 'a');
+    CHECK(parseAll(prefix + target + suffix + "\r\n\r\n", request) == HttpRequest::GET_REQUEST);
+    CHECK(parseAll(prefix + target + "a" + suffix + "\r\n\r\n", request)
+          == HttpRequest::BAD_REQUEST);
+    // 行尾尚未到达但已超过上限
+    CHECK(parseAll(prefix + target + "a" + suffix, request) == HttpRequest::BAD_REQUEST);
+
+    std::string name = "X-Long: ";
+    std::string value(HttpRequest::MAX_LINE - name.size(), 'v');
+    CHECK(parseAll("GET / HTTP/1.1\r\n" + name + value + "\r\n\r\n", request)
+          == HttpRequest::GET_REQUEST);
+    CHECK(str(request.header("x-long")) == value);
+    CHECK(parseAll("GET / HTTP/1.1\r\n" + name + value + "v\r\n\r\n", request)
+          == HttpRequest::BAD_REQUEST);
+
+    // 请求头的数量上限
+    std::string headers;
+    for (int i = 0; i < HttpRequest::MAX_HEADERS; i++) {
+        headers += "X-" + std::to_string(i) + ": " + std::to_string(i) + "\r\n";
+    }
+    CHECK(parseAll("GET / HTTP/1.1\r\n" + headers + "\r\n", request) == HttpRequest::GET_REQUEST);
+    CHECK(str(request.header("x-31")) == "31");
+    CHECK(parseAll("GET / HTTP/1.1\r\n" + headers + "X-32: 32\r\n\r\n", request)
+          == HttpRequest::BAD_REQUEST);
+
+    // 请求头的总长度上限：每行都未超过上限，总长度超过时出错，未超过时等待更多数据
+    std::string big = "GET / HTTP/1.1\r\n";
+    std::string line = "X-Big: " + std::string(4000, 'b') + "\r\n";
+    while (big.size() + line.size() <= HttpRequest::MAX_HEADER_SIZE) {
+        big += line;
+    }
+    CHECK(parseAll(big, request) == HttpRequest::NO_REQUEST);
+    CHECK(parseAll(big + "\r\n", request) == HttpRequest::GET_REQUEST);
+    CHECK(request.Length() == big.size() + 2);
+    CHECK(parseAll(big + line + "\r\n", request) == HttpRequest::BAD_REQUEST);
+    // 请求头跨越多个块，从任意位置开始
+    for (size_t offset : {size_t(1), size_t(17), size_t(4000)}) {
+        Buffer buff;
+        HttpRequest parser;
+        appendAt(buff, offset, big + "\r\n");
+        CHECK(parser.parse(buff));
+        CHECK(parser.Length() == big.size() + 2);
+        CHECK(str(parser.header("x-big")) == std::string(4000, 'b'));
+    }
+}
+
+void testMalformed() {
+    HttpRequest request;
+    // 只有LF的行尾可以接受
+    CHECK(parseAll("GET /index HTTP/1.1\nHost: a\nConnection: keep-alive\n\n", request)
+          == HttpRequest::GET_REQUEST);
+    CHECK(str(request.path()) == "/index.html");
+    CHECK(str(request.header("host")) == "a");
+    CHECK(request.IsKeepAlive());
+    // 单独的CR与其他控制字符
+    CHECK(parseAll("GET / HTTP/1.1\r\nHost: a\rb\r\n\r\n", request) == HttpRequest::BAD_REQUEST);
+    const char nul[] = "GET / HTTP/1.1\r\nHost: a\0b\r\n\r\n";
+    CHECK(parseAll(std::string(nul, sizeof(nul) - 1), request) == HttpRequest::BAD_REQUEST);
+    // 续行
+    CHECK(parseAll("GET / HTTP/1.1\r\nX-A: a\r\n b\r\n\r\n", request) == HttpRequest::BAD_REQUEST);
+    CHECK(parseAll("GET / HTTP/1.1\r\nX-A: a\r\n\tb\r\n\r\n", request)
+          == HttpRequest::BAD_REQUEST);
+    // 冒号前的空白与错误的请求行
+    CHECK(parseAll("GET / HTTP/1.1\r\nHost : a\r\n\r\n", request) == HttpRequest::BAD_REQUEST);
+    CHECK(parseAll("GET /HTTP/1.1\r\n\r\n", request) == HttpRequest::BAD_REQUEST);
+    CHECK(parseAll("GET / FTP/1.1\r\n\r\n", request) == HttpRequest::BAD_REQUEST);
+    // 不支持分块传输
+    CHECK(parseAll("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n0\r\n\r\n", request)
+          == HttpRequest::BAD_REQUEST);
+    CHECK(parseAll("POST / HTTP/1.1\r\nContent-Length: 1\r\ntransfer-encoding: chunked\r\n\r\n1",
+                   request)
+          == HttpRequest::BAD_REQUEST);
+    // 相同的Content-Length可以重复，不同的不行
+    const std::string repeated = "POST / HTTP/1.1\r\nContent-Length: 3\r\nContent-Length: 3\r\n\r\nabc";
+    CHECK(parseAll(repeated, request) == HttpRequest::GET_REQUEST);
+    CHECK(request.Length() == repeated.size());
+    CHECK(parseAll("POST / HTTP/1.1\r\nContent-Length: 3\r\nContent-Length: 4\r\n\r\nabcd",
+                   request)
+          == HttpRequest::BAD_REQUEST);
+    CHECK(parseAll("POST / HTTP/1.1\r\nContent-Length: -1\r\n\r\n", request)
+          == HttpRequest::BAD_REQUEST);
+    CHECK(parseAll("POST / HTTP/1.1\r\nContent-Length: 1x\r\n\r\n", request)
+          == HttpRequest::BAD_REQUEST);
+    // 出错后不再解析
+    Buffer buff;
+    buff.Append(std::string("GET / HTTP/1.1\r\nX-A: a\r\n b\r\n\r\nGET / HTTP/1.1\r\n\r\n"));
+    CHECK(!request.parse(buff));
+    CHECK(!request.parse(buff));
+    CHECK(request.httpCode == HttpRequest::BAD_REQUEST);
+}
+
+// 流水线请求依次解析，每个请求处理完后取走Length()字节；请求体按Content-Length跳过
+void testPipeline() {
+    const std::string post = "POST /login HTTP/1.1\r\nContent-Length: 10\r\n\r\n0123456789";
+    const std::string batch = REQUEST + post + "\r\n" + REQUEST;
+    for (size_t offset = 0; offset <= batch.size(); offset += 7) {
+        Buffer buff;
+        HttpRequest request;
+        appendAt(buff, offset, batch);
+        CHECK(request.parse(buff));
+        checkRequest(request);
+        buff.Retrieve(request.Length());
+
+        CHECK(request.parse(buff));
+        CHECK(str(request.method()) == "POST");
+        CHECK(str(request.path()) == "/login.html");
+        CHECK(!request.IsKeepAlive());
+        CHECK(request.Length() == post.size());
+        buff.Retrieve(request.Length());
+
+        // 请求之前的空行忽略，计入请求的长度
+        CHECK(request.parse(buff));
+        CHECK(request.httpCode == HttpRequest::GET_REQUEST);
+        CHECK(request.Length() == sizeof(REQUEST) - 1 + 2);
+        buff.Retrieve(request.Length());
+        CHECK(buff.ReadableBytes() == 0);
+        CHECK(!request.parse(buff));
+        CHECK(request.httpCode == HttpRequest::NO_REQUEST);
+    }
+    // 请求体分几次到达
+    Buffer buff;
+    HttpRequest request;
+    buff.Append(post.data(), post.size() - 10);
+    CHECK(!request.parse(buff));
+    CHECK(request.state() == HttpRequest::BODY);
+    buff.Append(post.data() + post.size() - 10, 5);
+    CHECK(!request.parse(buff));
+    CHECK(request.httpCode == HttpRequest::NO_REQUEST);
+    buff.Append(post.data() + post.size() - 5, 5);
+    CHECK(request.parse(buff));
+    CHECK(request.Length() == post.size());
+}
+
+} // namespace
+
+int main() {
+    printf("scanner: %s\n", HttpRequest::Scanner());
+    testScanners();
+    testSplits();
+    testLimits();
+    testMalformed();
+    testPipeline();
+    puts("ok");
+    return 0;
+}
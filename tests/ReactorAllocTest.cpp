@@ -0,0 +1,122 @@
+// 事件分发、提交到线程池与投递回IO线程的任务在预热后不应再有堆分配
+// 以WS_ALLOC_STATS编译，通过socketpair触发读事件，分别检查IO线程与工作线程的分配次数
+
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+
+#include "../base/AllocStats.hpp"
+#include "../net/Reactor.hpp"
+
+#define CHECK(cond)                                                                  \
+    do {                                                                             \
+        if (!(cond)) {                                                               \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            exit(1);                                                                 \
+        }                                                                            \
+    } while (0)
+
+namespace {
+
+const int WARMUP = 16;
+const int ROUNDS = 256;
+
+// 处理器只捕获该结构的引用，能放入Channel的内联回调
+struct State {
+    Reactor *reactor;
+    int fd;
+    // 各线程在处理每一轮时记录的本线程累计分配次数
+    std::atomic<uint64_t> loopAllocs{0};
+    std::atomic<uint64_t> workerAllocs{0};
+    std::atomic<int> done{0};
+};
+
+void run(Poller::Backend backend) {
+    // 固定一个工作线程，任务总在同一线程中执行，其分配次数可以前后比较
+    auto pool = std::make_shared<ThreadPool>(1);
+    Reactor reactor(pool, backend);
+
+    int fds[2];
+    CHECK(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds) == 0);
+
+    State state;
+    state.reactor = &reactor;
+    state.fd = fds[0];
+
+    auto channel = std::make_shared<Channel>(fds[0]);
+    channel->setEvents(EPOLLIN | EPOLLET);
+    channel->setReadHandler([&state] {
+        char buf[64];
+        while (read(state.fd, buf, sizeof(buf)) > 0) {
+        }
+        state.loopAllocs.store(AllocStats::threadCount());
+        state.reactor->appendToThreadPool([&state] {
+            state.workerAllocs.store(AllocStats::threadCount());
+            // 工作线程投递回IO线程，经过待执行队列
+            state.reactor->runInLoop([&state] { state.done.fetch_add(1); });
+        });
+    });
+    reactor.runInLoop([&] { reactor.addToPoller(channel); });
+    std::thread loop([&] { reactor.loop(); });
+
+    // 任务节点在工作线程执行完任务后才放回空闲列表，可能晚于下一次提交；
+    // 预先让几个任务同时在队列中（第一个任务等到全部提交后才返回），使空闲列表中有多余的节点，
+    // 这种重叠不会第一次出现在测量期间
+    std::atomic<bool> submitted{false};
+    std::atomic<int> spare{0};
+    for (int i = 0; i < 4; i++) {
+        pool->append([&submitted, &spare] {
+            while (!submitted.load()) {
+                std::this_thread::yield();
+            }
+            spare.fetch_add(1);
+        });
+    }
+    submitted.store(true);
+    while (spare.load() != 4) {
+        std::this_thread::yield();
+    }
+
+    uint64_t loopBase = 0;
+    uint64_t workerBase = 0;
+    for (int i = 0; i < WARMUP + ROUNDS; i++) {
+        if (i == WARMUP) {
+            loopBase = state.loopAllocs.load();
+            workerBase = state.workerAllocs.load();
+        }
+        char byte = 'x';
+        CHECK(write(fds[1], &byte, 1) == 1);
+        while (state.done.load() != i + 1) {
+            std::this_thread::yield();
+        }
+    }
+    auto loopDelta = state.loopAllocs.load() - loopBase;
+    auto workerDelta = state.workerAllocs.load() - workerBase;
+    printf("%s: %d events, %llu loop allocations, %llu worker allocations\n",
+           reactor.getPollerName(), ROUNDS, (unsigned long long)loopDelta,
+           (unsigned long long)workerDelta);
+    CHECK(loopDelta == 0);
+    CHECK(workerDelta == 0);
+
+    reactor.quit();
+    loop.join();
+    close(fds[0]);
+    close(fds[1]);
+}
+
+} // namespace
+
+int main() {
+    if (!AllocStats::enabled()) {
+        fprintf(stderr, "built without WS_ALLOC_STATS\n");
+        return 1;
+    }
+    run(Poller::EPOLL);
+    // 内核不支持时退回epoll
+    run(Poller::IO_URING);
+    return 0;
+}
@@ -0,0 +1,225 @@
+// 分层时间轮：定时器跨越各层边界（256与64×256个刻度）时按时到期，刷新推迟到期时间后
+// 在原来的槽到期时重新放入，取消只清除位图中的位，节点在所在槽到期时回收
+// 通过CoarseClock::setMonotonicMs控制时间，不需要等待
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "../base/Clock.hpp"
+#include "../base/TimingWheel.hpp"
+
+#define CHECK(cond)                                                                  \
+    do {                                                                             \
+        if (!(cond)) {                                                               \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            exit(1);                                                                 \
+        }                                                                            \
+    } while (0)
+
+namespace {
+
+// 测试开始时的时钟，避免从0开始
+const int64_t BASE_MS = 1000000;
+// 刻度为1ms，刻度数与毫秒数相同
+const int ROOT_SLOTS = 256;
+const int LEVEL1_SPAN = 64 * 256;
+const int LEVEL2_SPAN = 64 * 64 * 256;
+
+struct Fired {
+    int id;
+    int64_t at;
+};
+
+std::vector<Fired> fired;
+
+void setNow(int64_t ms) {
+    CoarseClock::setMonotonicMs(BASE_MS + ms);
+}
+
+int64_t now() {
+    return CoarseClock::monotonicMs() - BASE_MS;
+}
+
+void arm(TimingWheel &wheel, int id, int timeout) {
+    wheel.add(id, timeout, [id] { fired.push_back({id, now()}); });
+}
+
+// 将时间推进到ms并处理到期的定时器
+void advance(TimingWheel &wheel, int64_t ms) {
+    setNow(ms);
+    wheel.getNextTick();
+}
+
+// 定时器在at之前一个刻度仍未到期，恰好在at到期
+void checkFiresAt(TimingWheel &wheel, int id, int64_t at) {
+    advance(wheel, at - 1);
+    for (auto &event : fired) {
+        CHECK(event.id != id);
+    }
+    advance(wheel, at);
+    CHECK(!fired.empty() && fired.back().id == id && fired.back().at == at);
+}
+
+// 第0层的最后一个槽、第1层的第一个与最后一个刻度、第2层与第3层的开始，从对齐与未对齐的时刻注册
+void testLevelBoundaries() {
+    const int timeouts[] = {1,
+                            ROOT_SLOTS - 1,
+                            ROOT_SLOTS,
+                            ROOT_SLOTS + 1,
+                            LEVEL1_SPAN - 1,
+                            LEVEL1_SPAN,
+                            LEVEL1_SPAN + 1,
+                            LEVEL2_SPAN - 1,
+                            LEVEL2_SPAN,
+                            LEVEL2_SPAN + 1};
+    for (int64_t start : {int64_t(0), int64_t(100), int64_t(ROOT_SLOTS - 1), int64_t(12345)}) {
+        for (int timeout : timeouts) {
+            setNow(0);
+            TimingWheel wheel(16, 1);
+            advance(wheel, start);
+            fired.clear();
+            arm(wheel, 3, timeout);
+            CHECK(wheel.size() == 1);
+            checkFiresAt(wheel, 3, start + timeout);
+            CHECK(fired.size() == 1);
+            CHECK(wheel.size() == 0);
+            CHECK(wheel.getNextTick() == -1);
+        }
+    }
+
+    // 多个定时器同时在各层中，依次到期
+    setNow(0);
+    TimingWheel wheel(16, 1);
+    fired.clear();
+    for (int i = 0; i < 10; i++) {
+        arm(wheel, i, timeouts[i]);
+    }
+    CHECK(wheel.size() == 10);
+    advance(wheel, LEVEL2_SPAN + 1);
+    CHECK(fired.size() == 10);
+    for (int i = 0; i < 10; i++) {
+        CHECK(fired[i].id == i);
+    }
+}
+
+// 刷新（以相同id再次add）推迟到期时间时节点不移动，原来的槽到期时按新的到期时间重新放入
+void testPushBack() {
+    setNow(0);
+    TimingWheel wheel(16, 1);
+    fired.clear();
+    arm(wheel, 1, 100);
+    advance(wheel, 50);
+    arm(wheel, 1, 300);
+    advance(wheel, 100);
+    CHECK(fired.empty());
+    CHECK(wheel.size() == 1);
+    checkFiresAt(wheel, 1, 350);
+
+    // 推迟到更高的层，且多次推迟
+    fired.clear();
+    arm(wheel, 2, 200);
+    advance(wheel, 500);
+    arm(wheel, 2, LEVEL1_SPAN);
+    advance(wheel, 550);
+    arm(wheel, 2, LEVEL1_SPAN + 7);
+    checkFiresAt(wheel, 2, 550 + LEVEL1_SPAN + 7);
+    CHECK(fired.size() == 1);
+
+    // 提前到期时间时立即移到新的槽
+    fired.clear();
+    setNow(0);
+    TimingWheel early(16, 1);
+    arm(early, 4, LEVEL1_SPAN);
+    arm(early, 4, 10);
+    checkFiresAt(early, 4, 10);
+    advance(early, LEVEL1_SPAN + 1);
+    CHECK(fired.size() == 1);
+    CHECK(early.getNextTick() == -1);
+
+    // 到期处理中的回调重新注册同一id
+    fired.clear();
+    setNow(0);
+    TimingWheel again(16, 1);
+    again.add(5, 20, [&again] {
+        fired.push_back({5, now()});
+        arm(again, 5, 30);
+    });
+    advance(again, 20);
+    CHECK(fired.size() == 1 && fired[0].at == 20);
+    CHECK(again.size() == 1);
+    fired.clear();
+    checkFiresAt(again, 5, 50);
+}
+
+// 取消只清除位图中的位：计数立即减少，回调不再执行，节点在所在槽到期时回收
+void testCancel() {
+    setNow(0);
+    TimingWheel wheel(128, 1);
+    fired.clear();
+    arm(wheel, 1, 10);
+    arm(wheel, 70, LEVEL1_SPAN + 3);
+    arm(wheel, 127, 500);
+    CHECK(wheel.size() == 3);
+    wheel.disable(70);
+    wheel.disable(70);
+    CHECK(wheel.size() == 2);
+    wheel.disable(127);
+    CHECK(wheel.size() == 1);
+    // 从未注册的id
+    wheel.disable(2);
+    CHECK(wheel.size() == 1);
+
+    advance(wheel, 10);
+    CHECK(fired.size() == 1 && fired[0].id == 1);
+    // 已取消的节点仍在槽中，下一次处理时间为其所在槽
+    CHECK(wheel.getNextTick() > 0);
+    advance(wheel, LEVEL1_SPAN + 3);
+    CHECK(fired.size() == 1);
+    CHECK(wheel.getNextTick() == -1);
+
+    // 取消后在节点回收前重新注册，只按新的时间到期一次
+    fired.clear();
+    arm(wheel, 9, 100);
+    wheel.disable(9);
+    arm(wheel, 9, 40);
+    CHECK(wheel.size() == 1);
+    checkFiresAt(wheel, 9, LEVEL1_SPAN + 3 + 40);
+    advance(wheel, LEVEL1_SPAN + 3 + 200);
+    CHECK(fired.size() == 1);
+
+    // clear取消全部定时器
+    arm(wheel, 1, 10);
+    arm(wheel, 2, LEVEL2_SPAN);
+    wheel.clear();
+    CHECK(wheel.size() == 0);
+    CHECK(wheel.getNextTick() == -1);
+}
+
+// getNextTick返回距下一个非空的第0层槽的毫秒数，第0层为空时为其转完一圈的时刻
+void testNextTick() {
+    setNow(0);
+    TimingWheel wheel(16, 10);
+    fired.clear();
+    CHECK(wheel.getNextTick() == -1);
+    arm(wheel, 1, 95);
+    CHECK(wheel.getNextTick() == 100);
+    advance(wheel, 40);
+    CHECK(wheel.getNextTick() == 60);
+    arm(wheel, 2, 100000);
+    CHECK(wheel.getNextTick() == 60);
+    advance(wheel, 100);
+    CHECK(fired.size() == 1 && fired[0].id == 1);
+    CHECK(wheel.getNextTick() == ROOT_SLOTS * 10 - 100);
+}
+
+} // namespace
+
+int main() {
+    testLevelBoundaries();
+    testPushBack();
+    testCancel();
+    testNextTick();
+    puts("ok");
+    return 0;
+}